@@ -23,24 +23,48 @@ die "Unable to find PDK; this is required"
 
 # Compile stuff
 my @SOURCE = qw(
+   alliance.c
+   alliance.h
+   baseindex.c
+   baseindex.h
    config.c
    config.h
    credits.c
    credits.h
+   fcode.c
+   fcode.h
+   hostdata.c
+   hostdata.h
    language.c
    language.h
    message.c
    message.h
    mine.c
    mine.h
+   mineindex.c
+   mineindex.h
+   prescan.c
+   prescan.h
+   profile.c
+   profile.h
+   schedule.c
+   schedule.h
    transport.c
    transport.h
+   trim.c
+   trim.h
    sendconf.c
    sendconf.h
+   snapshot.c
+   snapshot.h
+   statefile.c
+   statefile.h
    util.c
    util.h
    utildata.c
    utildata.h
+   utilfile.c
+   utilfile.h
 );
 compile_static_library('sbr', [to_prefix_list($V{IN}, @SOURCE)]);
 
@@ -48,6 +72,28 @@ compile_executable('sbreload',
                    [to_prefix_list($V{IN}, qw(main.c))],
                    [qw(sbr)]);
 
+# Tests
+my @TESTS = qw(
+   fcode_test
+   hostdata_test
+   statefile_test
+   trim_test
+);
+foreach (@TESTS) {
+    compile_executable($_,
+                       [to_prefix_list($V{IN}, "test/$_.c")],
+                       [qw(sbr)]);
+}
+generate('test', [@TESTS], map {"./$_"} @TESTS);
+rule_set_phony('test');
+
+# Benchmarks
+compile_executable('utilfile_bench',
+                   [to_prefix_list($V{IN}, qw(test/utilfile_bench.c))],
+                   [qw(sbr)]);
+generate('bench', ['utilfile_bench'], './utilfile_bench');
+rule_set_phony('bench');
+
 
 # Coverage rules for convenience
 if ($V{WITH_COVERAGE}) {
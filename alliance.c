@@ -0,0 +1,58 @@
+/**
+  *  \file alliance.c
+  *  \brief Starbase Reloaded - Alliance Permissions
+  */
+
+#include <string.h>
+#include "alliance.h"
+
+static Boolean IsValidPlayer(RaceType_Def player)
+{
+    return player > 0 && player <= RACE_NR;
+}
+
+static Uns32 OwnerBit(RaceType_Def owner)
+{
+    return 1UL << (owner <= RACE_NR ? owner : 0);
+}
+
+static Boolean HaveMineAlliance(RaceType_Def a, RaceType_Def b)
+{
+    return PlayersAreAllies(a, b)
+        && PlayerAllowsAlly(a, b, ALLY_MINES)
+        && PlayerAllowsAlly(b, a, ALLY_MINES);
+}
+
+void Alliances_Init(struct Alliances* a)
+{
+    memset(a, 0, sizeof(*a));
+    for (RaceType_Def player = 1; player <= RACE_NR; ++player) {
+        for (RaceType_Def owner = 0; owner <= RACE_NR; ++owner) {
+            if (owner == player) {
+                a->MayScoop[player] |= OwnerBit(owner);
+            } else if (owner == 0 || !HaveMineAlliance(player, owner)) {
+                a->MaySweep[player] |= OwnerBit(owner);
+            }
+        }
+    }
+}
+
+Uns32 Alliances_SweepMask(const struct Alliances* a, RaceType_Def player)
+{
+    return IsValidPlayer(player) ? a->MaySweep[player] : 0;
+}
+
+Uns32 Alliances_ScoopMask(const struct Alliances* a, RaceType_Def player)
+{
+    return IsValidPlayer(player) ? a->MayScoop[player] : 0;
+}
+
+Boolean Alliances_MaySweep(const struct Alliances* a, RaceType_Def player, RaceType_Def owner)
+{
+    return (Alliances_SweepMask(a, player) & OwnerBit(owner)) != 0;
+}
+
+Boolean Alliances_MayScoop(const struct Alliances* a, RaceType_Def player, RaceType_Def owner)
+{
+    return (Alliances_ScoopMask(a, player) & OwnerBit(owner)) != 0;
+}
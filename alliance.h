@@ -0,0 +1,55 @@
+/**
+  *  \file alliance.h
+  *  \brief Starbase Reloaded - Alliance Permissions
+  *
+  *  Alliances do not change while we run, so permissions that depend on
+  *  alliances are computed once and stored as bit matrix.
+  *  Each row is an owner mask (bit N set for owner N), compatible with
+  *  the owner masks used for minefield queries.
+  */
+#ifndef ALLIANCE_H_INCLUDED
+#define ALLIANCE_H_INCLUDED
+
+#include <phostpdk.h>
+
+/** Alliance permissions. */
+struct Alliances {
+    Uns32 MaySweep[RACE_NR+1];          /**< For each player, owners whose minefields the player may sweep. */
+    Uns32 MayScoop[RACE_NR+1];          /**< For each player, owners whose minefields the player may scoop. */
+};
+
+/** Compute alliance permissions.
+    @param [out] a Permissions
+    @pre PDK has loaded host data (ReadHostData) */
+void Alliances_Init(struct Alliances* a);
+
+/** Get owners whose minefields a player may sweep.
+    A player sweeps all minefields except own ones and those of players
+    with a bidirectional mine-level alliance.
+    @param [in] a      Permissions
+    @param [in] player Player
+    @return Owner mask; 0 if player is out of range */
+Uns32 Alliances_SweepMask(const struct Alliances* a, RaceType_Def player);
+
+/** Get owners whose minefields a player may scoop.
+    A player only scoops own minefields.
+    @param [in] a      Permissions
+    @param [in] player Player
+    @return Owner mask; 0 if player is out of range */
+Uns32 Alliances_ScoopMask(const struct Alliances* a, RaceType_Def player);
+
+/** Check whether a player may sweep another player's minefields.
+    @param [in] a      Permissions
+    @param [in] player Sweeping player
+    @param [in] owner  Minefield owner; out-of-range values are treated as 0
+    @return result */
+Boolean Alliances_MaySweep(const struct Alliances* a, RaceType_Def player, RaceType_Def owner);
+
+/** Check whether a player may scoop another player's minefields.
+    @param [in] a      Permissions
+    @param [in] player Scooping player
+    @param [in] owner  Minefield owner; out-of-range values are treated as 0
+    @return result */
+Boolean Alliances_MayScoop(const struct Alliances* a, RaceType_Def player, RaceType_Def owner);
+
+#endif
@@ -0,0 +1,73 @@
+/**
+  *  \file baseindex.c
+  *  \brief Starbase Reloaded - Starbase Location Index
+  */
+
+#include <string.h>
+#include "baseindex.h"
+
+static Uns32 Bucket(Uns16 x, Uns16 y)
+{
+    return (((Uns32) x * 0x9E3779B1u) ^ ((Uns32) y * 0x85EBCA77u)) >> (32 - BASEINDEX_BUCKET_BITS);
+}
+
+void BaseIndex_Init(struct BaseIndex* idx)
+{
+    memset(idx, 0, sizeof(*idx));
+}
+
+void BaseIndex_AddBase(struct BaseIndex* idx, Uns16 planetId, Uns16 x, Uns16 y)
+{
+    if (planetId > 0 && planetId <= PLANET_NR) {
+        // Append to bucket, so that an earlier base at the same position takes precedence
+        Uns16* p = &idx->Head[Bucket(x, y)];
+        while (*p != 0) {
+            p = &idx->NextBase[*p];
+        }
+        *p = planetId;
+        idx->NextBase[planetId] = 0;
+        idx->X[planetId] = x;
+        idx->Y[planetId] = y;
+    }
+}
+
+void BaseIndex_AddShip(struct BaseIndex* idx, Uns16 shipId, Uns16 x, Uns16 y)
+{
+    if (shipId > 0 && shipId <= SHIP_NR) {
+        const Uns16 planetId = BaseIndex_Find(idx, x, y);
+        idx->ShipBase[shipId] = planetId;
+        if (planetId != 0) {
+            if (idx->LastShip[planetId] != 0) {
+                idx->NextShip[idx->LastShip[planetId]] = shipId;
+            } else {
+                idx->FirstShip[planetId] = shipId;
+            }
+            idx->LastShip[planetId] = shipId;
+        }
+    }
+}
+
+Uns16 BaseIndex_Find(const struct BaseIndex* idx, Uns16 x, Uns16 y)
+{
+    for (Uns16 planetId = idx->Head[Bucket(x, y)]; planetId != 0; planetId = idx->NextBase[planetId]) {
+        if (idx->X[planetId] == x && idx->Y[planetId] == y) {
+            return planetId;
+        }
+    }
+    return 0;
+}
+
+Uns16 BaseIndex_ShipBase(const struct BaseIndex* idx, Uns16 shipId)
+{
+    return (shipId > 0 && shipId <= SHIP_NR ? idx->ShipBase[shipId] : 0);
+}
+
+Uns16 BaseIndex_FirstShip(const struct BaseIndex* idx, Uns16 planetId)
+{
+    return (planetId > 0 && planetId <= PLANET_NR ? idx->FirstShip[planetId] : 0);
+}
+
+Uns16 BaseIndex_NextShip(const struct BaseIndex* idx, Uns16 shipId)
+{
+    return (shipId > 0 && shipId <= SHIP_NR ? idx->NextShip[shipId] : 0);
+}
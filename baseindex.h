@@ -0,0 +1,76 @@
+/**
+  *  \file baseindex.h
+  *  \brief Starbase Reloaded - Starbase Location Index
+  *
+  *  Maps positions to planets with a starbase, using a hash table keyed
+  *  by exact position. Ships are assigned to the starbase at their
+  *  position once, so stages can find a ship's base, or all ships at a
+  *  base, without location lookups.
+  *
+  *  The index is built when the snapshot is loaded; ships do not move
+  *  and bases are not created or destroyed while we run.
+  */
+#ifndef BASEINDEX_H_INCLUDED
+#define BASEINDEX_H_INCLUDED
+
+#include <phostpdk.h>
+
+#define BASEINDEX_BUCKET_BITS 9
+#define BASEINDEX_BUCKETS     (1 << BASEINDEX_BUCKET_BITS)
+
+/** Starbase index. */
+struct BaseIndex {
+    Uns16 Head[BASEINDEX_BUCKETS];              /**< First base in each bucket. */
+    Uns16 NextBase[PLANET_NR+1];                /**< Next base in same bucket. */
+    Uns16 X[PLANET_NR+1];                       /**< Base position. */
+    Uns16 Y[PLANET_NR+1];                       /**< Base position. */
+    Uns16 FirstShip[PLANET_NR+1];               /**< First ship at each base. */
+    Uns16 LastShip[PLANET_NR+1];                /**< Last ship at each base. */
+    Uns16 NextShip[SHIP_NR+1];                  /**< Next ship at same base. */
+    Uns16 ShipBase[SHIP_NR+1];                  /**< Base at each ship; 0 if none. */
+};
+
+/** Initialize empty index.
+    @param [out] idx Index */
+void BaseIndex_Init(struct BaseIndex* idx);
+
+/** Add starbase.
+    If two bases share a position, the one added first is found.
+    @param [in,out] idx      Index
+    @param [in]     planetId Planet Id
+    @param [in]     x,y      Position */
+void BaseIndex_AddBase(struct BaseIndex* idx, Uns16 planetId, Uns16 x, Uns16 y);
+
+/** Add ship.
+    Assigns the ship to the base at its position, if any.
+    Ships must be added in ascending Id order, after all bases.
+    @param [in,out] idx    Index
+    @param [in]     shipId Ship Id
+    @param [in]     x,y    Position */
+void BaseIndex_AddShip(struct BaseIndex* idx, Uns16 shipId, Uns16 x, Uns16 y);
+
+/** Find starbase at a position.
+    @param [in] idx Index
+    @param [in] x,y Position
+    @return Planet Id; 0 if none */
+Uns16 BaseIndex_Find(const struct BaseIndex* idx, Uns16 x, Uns16 y);
+
+/** Get starbase at a ship.
+    @param [in] idx    Index
+    @param [in] shipId Ship Id
+    @return Planet Id; 0 if ship is not at a starbase */
+Uns16 BaseIndex_ShipBase(const struct BaseIndex* idx, Uns16 shipId);
+
+/** Get first ship at a starbase.
+    @param [in] idx      Index
+    @param [in] planetId Planet Id
+    @return Ship Id; 0 if none */
+Uns16 BaseIndex_FirstShip(const struct BaseIndex* idx, Uns16 planetId);
+
+/** Get next ship at the same starbase.
+    @param [in] idx    Index
+    @param [in] shipId Ship Id
+    @return Ship Id (greater than shipId); 0 if none */
+Uns16 BaseIndex_NextShip(const struct BaseIndex* idx, Uns16 shipId);
+
+#endif
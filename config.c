@@ -52,6 +52,14 @@ static const struct Definition CONFIG_DEFINITION[] = {
     CONFIG(Boolean, NonCloakerCarryOnly),
     CONFIG(Uns16,   CargoSpacePerComp),
     CONFIG(Boolean, TagSpecialTransport),
+    CONFIG(Boolean, TransportDigest),
+    CONFIG(Boolean, TransportUtilRecords),
+    CONFIG(Boolean, TransportUtilManifest),
+    CONFIG(Uns16,   TransportReportInterval),
+
+    CONFIG(Boolean, SkipIdleTurns),
+    CONFIG(Uns16,   StateHistoryTurns),
+    CONFIG(Boolean, ScanUtilForNewShips),
 };
 
 /*
@@ -138,6 +146,14 @@ void Config_Init(struct Config* p)
     p->NonCloakerCarryOnly = True;
     p->CargoSpacePerComp = 40;
     p->TagSpecialTransport = True;
+    p->TransportDigest = False;
+    p->TransportUtilRecords = True;
+    p->TransportUtilManifest = False;
+    p->TransportReportInterval = 1;
+
+    p->SkipIdleTurns = False;
+    p->StateHistoryTurns = 5;
+    p->ScanUtilForNewShips = False;
 }
 
 void Config_Load(struct Config* p)
@@ -32,6 +32,14 @@ struct Config {
     Boolean NonCloakerCarryOnly;
     Uns16   CargoSpacePerComp;
     Boolean TagSpecialTransport;
+    Boolean TransportDigest;
+    Boolean TransportUtilRecords;
+    Boolean TransportUtilManifest;
+    Uns16   TransportReportInterval;
+
+    Boolean SkipIdleTurns;
+    Uns16   StateHistoryTurns;
+    Boolean ScanUtilForNewShips;
 };
 
 /** Initialize configuration.
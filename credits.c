@@ -6,23 +6,22 @@
 #include <phostpdk.h>
 #include "credits.h"
 #include "config.h"
+#include "snapshot.h"
+#include "fcode.h"
 #include "util.h"
 #include "message.h"
 
 const int MIN_TOTAL_TECH = 20; /* FIXME: put in config */
 
-const int MAX_FCODE = 5;
-
 struct State {
     Uns16 ReceivingBase[RACE_NR+1];
 };
 
-static Boolean BaseCanTransfer(const struct Config* c, Uns16 baseId)
+static Boolean BaseCanTransfer(const struct Snapshot* s, const struct Config* c, Uns16 baseId)
 {
     (void) c;
 
-    return ((BaseTech(baseId, HULL_TECH) + BaseTech(baseId, ENGINE_TECH) + BaseTech(baseId, BEAM_TECH) + BaseTech(baseId, TORP_TECH))
-            >= MIN_TOTAL_TECH);
+    return s->Profiles.Bases[baseId].TotalTech >= MIN_TOTAL_TECH;
 }
 
 static void Credit_Init(struct State* p)
@@ -33,14 +32,15 @@ static void Credit_Init(struct State* p)
     }
 }
 
-static void Credit_FindReceivers(struct State* p, const struct Config* c)
+static void Credit_FindReceivers(struct State* p, const struct Snapshot* s, const struct Config* c)
 {
-    int i;
-    for (i = 1; i <= PLANET_NR; ++i) {
-        if (IsBaseExist(i) && PlanetHasFCode(i, "RMT")) {
-            RaceType_Def owner = BaseOwner(i);
+    const struct ScheduleList list = Schedule_Get(&s->Schedule, SS_ReceiveMoney);
+    for (Uns16 n = 0; n < list.Count; ++n) {
+        const Uns16 i = list.Ids[n];
+        if (s->Bases.Exists[i]) {
+            RaceType_Def owner = s->Bases.Owner[i];
             if (owner > 0 && owner <= RACE_NR) {
-                if (BaseCanTransfer(c, i)) {
+                if (BaseCanTransfer(s, c, i)) {
                     if (p->ReceivingBase[owner] == 0) {
                         Info("\t(+) Base %d, player %d: receives", i, owner);
                         p->ReceivingBase[owner] = i;
@@ -56,14 +56,16 @@ static void Credit_FindReceivers(struct State* p, const struct Config* c)
     }
 }
 
-static void Credit_ProcessSenders(struct State* p, const struct Config* c)
+static void Credit_ProcessSenders(struct State* p, struct Snapshot* s, const struct Config* c)
 {
-    int i, amount;
-    for (i = 1; i <= PLANET_NR; ++i) {
-        if (IsBaseExist(i) && (amount = PlanetMatchFCode(i, "TM", MAX_FCODE)) != 0) {
-            RaceType_Def owner = BaseOwner(i);
+    const struct ScheduleList list = Schedule_Get(&s->Schedule, SS_TransferMoney);
+    for (Uns16 n = 0; n < list.Count; ++n) {
+        const Uns16 i = list.Ids[n];
+        if (s->Bases.Exists[i]) {
+            int amount = s->Planets.ActionArg[i];
+            RaceType_Def owner = s->Bases.Owner[i];
             if (owner > 0 && owner <= RACE_NR) {
-                if (BaseCanTransfer(c, i)) {
+                if (BaseCanTransfer(s, c, i)) {
                     Uns16 to = p->ReceivingBase[owner];
                     if (to == 0) {
                         Info("\t(-) Base %d, player %d: no receiver for transmission", i, owner);
@@ -71,12 +73,12 @@ static void Credit_ProcessSenders(struct State* p, const struct Config* c)
                         // Determine amount to transfer
                         Uns32 want = 1000 * amount;
                         Uns32 allowed = c->MaxMCTransfer;
-                        Uns32 have = PlanetCargo(i, CREDITS);
+                        Uns32 have = s->Planets.Credits[i];
                         Uns32 toTransfer = MIN(have, MIN(want, allowed));
                         Info("\t(+) Base %d, player %d: transfers %d mc to %d", i, owner, (int) toTransfer, to);
 
-                        PutPlanetCargo(to, CREDITS, PlanetCargo(to, CREDITS) + toTransfer);
-                        PutPlanetCargo(i,  CREDITS, PlanetCargo(i,  CREDITS) - toTransfer);
+                        Snapshot_PutPlanetCredits(s, to, s->Planets.Credits[to] + toTransfer);
+                        Snapshot_PutPlanetCredits(s, i,  s->Planets.Credits[i]  - toTransfer);
 
                         Message_Credits_Transferred(owner, i, to, toTransfer);
                     }
@@ -89,13 +91,7 @@ static void Credit_ProcessSenders(struct State* p, const struct Config* c)
     }
 }
 
-static void RegisterCreditFCodes()
-{
-    DefineSpecialFCodeSeries("TM", MAX_FCODE);
-    DefineSpecialFCode("RMT");
-}
-
-void DoCreditTransfer(const struct Config* c)
+void DoCreditTransfer(struct Snapshot* s, const struct Config* c)
 {
     if (!c->StarbaseMCTransfer || c->MaxMCTransfer == 0) {
         Info("    Credit transfers disabled.");
@@ -103,8 +99,9 @@ void DoCreditTransfer(const struct Config* c)
         struct State st;
         Info("    Credit transfers...");
         Credit_Init(&st);
-        Credit_FindReceivers(&st, c);
-        Credit_ProcessSenders(&st, c);
-        RegisterCreditFCodes();
+        Credit_FindReceivers(&st, s, c);
+        Credit_ProcessSenders(&st, s, c);
+        FCode_DefineSpecial(FC_TransferMoney);
+        FCode_DefineSpecial(FC_ReceiveMoney);
     }
 }
@@ -6,9 +6,11 @@
 #define CREDITS_H_INCLUDED
 
 struct Config;
+struct Snapshot;
 
 /** Credit transfer stage (TMx, RMT).
-    @param [in] Configuration */
-void DoCreditTransfer(const struct Config* c);
+    @param [in,out] s Game snapshot
+    @param [in]     c Configuration */
+void DoCreditTransfer(struct Snapshot* s, const struct Config* c);
 
 #endif
@@ -0,0 +1,169 @@
+/**
+  *  \file fcode.c
+  *  \brief Starbase Reloaded - Friendly Codes
+  */
+
+#include <string.h>
+#include "fcode.h"
+#include "hostdata.h"
+
+#define DIM(x) (sizeof(x)/sizeof(x[0]))
+
+/*
+ *  Definition of friendly codes
+ */
+
+/* A friendly code, or a series of friendly codes.
+   If Limit is nonzero, Code is a two-character prefix, followed by a digit up to Limit (0 meaning 10). */
+struct Definition {
+    const char*      Code;
+    Uns8             Limit;
+    enum FCodeAction Action;
+    enum FCodeTarget Target;
+    Boolean          BeforeMovement;
+};
+
+static const struct Definition FCODE_DEFINITION[] = {
+    { "RMT", 0,         FC_ReceiveMoney,   FCT_Planet, False },
+    { "TM",  5,         FC_TransferMoney,  FCT_Planet, False },
+    { "LMF", 0,         FC_LayMines,       FCT_Planet, True  },
+    { "LWF", 0,         FC_LayWebMines,    FCT_Planet, True  },
+    { "SMF", 0,         FC_SweepMines,     FCT_Planet, True  },
+    { "MSC", 0,         FC_ScoopMines,     FCT_Planet, True  },
+    { "con", 0,         FC_SendConfig,     FCT_Planet, False },
+    { "UAP", 0,         FC_UnloadAll,      FCT_Ship,   False },
+    { "UE",  ENGINE_NR, FC_UnloadEngine,   FCT_Ship,   False },
+    { "UB",  BEAM_NR,   FC_UnloadBeam,     FCT_Ship,   False },
+    { "UT",  TORP_NR,   FC_UnloadLauncher, FCT_Ship,   False },
+    { "GE",  ENGINE_NR, FC_GetEngine,      FCT_Ship,   False },
+    { "GB",  BEAM_NR,   FC_GetBeam,        FCT_Ship,   False },
+    { "GT",  TORP_NR,   FC_GetLauncher,    FCT_Ship,   False },
+};
+
+
+/*
+ *  Lookup table
+ *
+ *  All codes are expanded into a hash table using a perfect hash:
+ *  a multiplier is chosen such that no two codes share a slot,
+ *  so a lookup is a single probe.
+ */
+
+#define HASH_BITS 7
+#define HASH_SIZE (1 << HASH_BITS)
+
+struct Slot {
+    Uns32 Key;                 /* Packed code; 0 if slot is empty. */
+    Uns8  Definition;          /* Index into FCODE_DEFINITION. */
+    Uns8  Arg;                 /* Argument. */
+};
+
+static struct Slot gTable[HASH_SIZE];
+static Uns32 gMultiplier;
+
+static Uns32 PackCode(const char* fc)
+{
+    return (Uns32) (Uns8) fc[0] | ((Uns32) (Uns8) fc[1] << 8) | ((Uns32) (Uns8) fc[2] << 16);
+}
+
+static Uns32 Hash(Uns32 key, Uns32 multiplier)
+{
+    return (Uns32) (key * multiplier) >> (32 - HASH_BITS);
+}
+
+static Boolean AddCode(Uns32 multiplier, const char* code, Uns8 definition, Uns8 arg)
+{
+    const Uns32 key = PackCode(code);
+    struct Slot* p = &gTable[Hash(key, multiplier)];
+    if (p->Key != 0) {
+        return False;
+    }
+    p->Key = key;
+    p->Definition = definition;
+    p->Arg = arg;
+    return True;
+}
+
+static Boolean BuildTable(Uns32 multiplier)
+{
+    memset(gTable, 0, sizeof(gTable));
+    for (size_t i = 0; i < DIM(FCODE_DEFINITION); ++i) {
+        const struct Definition* def = &FCODE_DEFINITION[i];
+        if (def->Limit == 0) {
+            if (!AddCode(multiplier, def->Code, i, 0)) {
+                return False;
+            }
+        } else {
+            for (int n = 1; n <= def->Limit; ++n) {
+                const char fc[] = { def->Code[0], def->Code[1], '0' + (n%10) };
+                if (!AddCode(multiplier, fc, i, n)) {
+                    return False;
+                }
+            }
+        }
+    }
+    return True;
+}
+
+static void Init(void)
+{
+    if (gMultiplier == 0) {
+        Uns32 i = 0, multiplier;
+        do {
+            ++i;
+            multiplier = (Uns32) (0x9E3779B1u * i) | 1;
+        } while (!BuildTable(multiplier));
+        gMultiplier = multiplier;
+    }
+}
+
+
+/*
+ *  Public Interface
+ */
+
+enum FCodeAction FCode_Decode(const char* fc, enum FCodeTarget target, Uns16* arg)
+{
+    Init();
+
+    const Uns32 key = PackCode(fc);
+    const struct Slot* p = &gTable[Hash(key, gMultiplier)];
+    enum FCodeAction result = FC_None;
+    Uns16 resultArg = 0;
+    // An empty slot has Key 0, which is also the key of an all-NUL code; never match that.
+    if (p->Key != 0 && p->Key == key && FCODE_DEFINITION[p->Definition].Target == target) {
+        result = FCODE_DEFINITION[p->Definition].Action;
+        resultArg = p->Arg;
+    }
+    if (arg != NULL) {
+        *arg = resultArg;
+    }
+    return result;
+}
+
+Boolean FCode_IsBeforeMovement(enum FCodeAction action)
+{
+    for (size_t i = 0; i < DIM(FCODE_DEFINITION); ++i) {
+        if (FCODE_DEFINITION[i].Action == action) {
+            return FCODE_DEFINITION[i].BeforeMovement;
+        }
+    }
+    return False;
+}
+
+void FCode_DefineSpecial(enum FCodeAction action)
+{
+    for (size_t i = 0; i < DIM(FCODE_DEFINITION); ++i) {
+        const struct Definition* def = &FCODE_DEFINITION[i];
+        if (def->Action == action) {
+            if (def->Limit == 0) {
+                HostData_DefineSpecialFCode(def->Code);
+            } else {
+                for (int n = 1; n <= def->Limit; ++n) {
+                    char fc[] = { def->Code[0], def->Code[1], '0' + (n%10), '\0' };
+                    HostData_DefineSpecialFCode(fc);
+                }
+            }
+        }
+    }
+}
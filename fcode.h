@@ -0,0 +1,56 @@
+/**
+  *  \file fcode.h
+  *  \brief Starbase Reloaded - Friendly Codes
+  *
+  *  All friendly codes are defined in a single table.
+  *  Each code maps to an action and a numeric argument (e.g. "GE3" is FC_GetEngine, 3).
+  */
+#ifndef FCODE_H_INCLUDED
+#define FCODE_H_INCLUDED
+
+#include <phostpdk.h>
+
+/** Friendly code action. */
+enum FCodeAction {
+    FC_None,
+    FC_ReceiveMoney,          /**< RMT: receive money. */
+    FC_TransferMoney,         /**< TMn: transfer n*1000 mc. */
+    FC_LayMines,              /**< LMF: lay minefield. */
+    FC_LayWebMines,           /**< LWF: lay web minefield. */
+    FC_SweepMines,            /**< SMF: sweep minefields. */
+    FC_ScoopMines,            /**< MSC: scoop minefields. */
+    FC_SendConfig,            /**< con: send configuration. */
+    FC_UnloadAll,             /**< UAP: unload all components. */
+    FC_UnloadEngine,          /**< UEn: unload engines of type n. */
+    FC_UnloadBeam,            /**< UBn: unload beams of type n. */
+    FC_UnloadLauncher,        /**< UTn: unload torpedo launchers of type n. */
+    FC_GetEngine,             /**< GEn: load engines of type n. */
+    FC_GetBeam,               /**< GBn: load beams of type n. */
+    FC_GetLauncher            /**< GTn: load torpedo launchers of type n. */
+};
+
+/** Object type a friendly code applies to. */
+enum FCodeTarget {
+    FCT_Planet,
+    FCT_Ship
+};
+
+/** Decode a friendly code.
+    Codes are checked case-sensitively.
+    @param [in]  fc     Friendly code (3 characters, not null-terminated)
+    @param [in]  target Object type the code is set on
+    @param [out] arg    Numeric argument (digit, with 0 representing 10); 0 for codes without argument. Can be null.
+    @return Action; FC_None if the code has no meaning for this object type */
+enum FCodeAction FCode_Decode(const char* fc, enum FCodeTarget target, Uns16* arg);
+
+/** Get phase of an action.
+    @param [in] action Action
+    @return True if action is processed in auxhost1 (before movement), false if in auxhost2 */
+Boolean FCode_IsBeforeMovement(enum FCodeAction action);
+
+/** Define friendly codes as special.
+    Calls DefineSpecialFCode for all codes that map to the given action.
+    @param [in] action Action */
+void FCode_DefineSpecial(enum FCodeAction action);
+
+#endif
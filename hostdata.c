@@ -0,0 +1,161 @@
+/**
+  *  \file hostdata.c
+  *  \brief Starbase Reloaded - Host Data Modification Tracking
+  */
+
+#include <string.h>
+#include "hostdata.h"
+
+#define DIM(x) (sizeof(x)/sizeof(x[0]))
+
+/* Maximum number of special friendly codes. We define about 70. */
+#define MAX_SPECIAL_FCODES 128
+
+static unsigned gModified;
+
+static char gSpecialFCodes[MAX_SPECIAL_FCODES][4];
+static size_t gNumSpecialFCodes;
+
+static const struct {
+    unsigned    Class;
+    const char* Name;
+} CLASS_NAMES[] = {
+    { HD_Planets,    "planets" },
+    { HD_Bases,      "bases" },
+    { HD_Ships,      "ships" },
+    { HD_Minefields, "minefields" },
+    { HD_Messages,   "messages" },
+    { HD_UtilRecords, "util.dat" },
+};
+
+void HostData_PutPlanetCargo(Uns16 planetId, CargoType_Def type, Uns32 amount)
+{
+    PutPlanetCargo(planetId, type, amount);
+    gModified |= HD_Planets;
+}
+
+void HostData_PutBaseTorps(Uns16 planetId, Uns16 torpNr, Uns16 amount)
+{
+    PutBaseTorps(planetId, torpNr, amount);
+    gModified |= HD_Bases;
+}
+
+void HostData_PutBaseEngines(Uns16 planetId, Uns16 slot, Uns16 amount)
+{
+    PutBaseEngines(planetId, slot, amount);
+    gModified |= HD_Bases;
+}
+
+void HostData_PutBaseBeams(Uns16 planetId, Uns16 slot, Uns16 amount)
+{
+    PutBaseBeams(planetId, slot, amount);
+    gModified |= HD_Bases;
+}
+
+void HostData_PutBaseTubes(Uns16 planetId, Uns16 slot, Uns16 amount)
+{
+    PutBaseTubes(planetId, slot, amount);
+    gModified |= HD_Bases;
+}
+
+void HostData_PutShipCargo(Uns16 shipId, CargoType_Def type, Uns16 amount)
+{
+    PutShipCargo(shipId, type, amount);
+    gModified |= HD_Ships;
+}
+
+void HostData_PutShipAmmunition(Uns16 shipId, Uns16 amount)
+{
+    PutShipAmmunition(shipId, amount);
+    gModified |= HD_Ships;
+}
+
+void HostData_PutShipName(Uns16 shipId, const char* name)
+{
+    PutShipName(shipId, name);
+    gModified |= HD_Ships;
+}
+
+void HostData_PutMinefieldUnits(Uns16 mineId, Uns32 units)
+{
+    PutMinefieldUnits(mineId, units);
+    gModified |= HD_Minefields;
+}
+
+Uns16 HostData_CreateMinefield(Uns16 x, Uns16 y, RaceType_Def owner, Uns32 units, Boolean isWeb)
+{
+    Uns16 mineId = CreateMinefield(x, y, owner, units, isWeb);
+    if (mineId != 0) {
+        gModified |= HD_Minefields;
+    }
+    return mineId;
+}
+
+void HostData_WriteMessage(RaceType_Def to, const char* text)
+{
+    // We cannot tell whether the PDK delivers messages immediately or as part of WriteHostData,
+    // so treat them like host data.
+    WriteAUXHOSTMessage(to, text);
+    gModified |= HD_Messages;
+}
+
+void HostData_PutUtilRecord(RaceType_Def to, Uns16 type, Uns16 size, const void* data)
+{
+    // Like messages, util.dat records may be buffered by the PDK until WriteHostData.
+    PutUtilRecordSimple(to, type, size, data);
+    gModified |= HD_UtilRecords;
+}
+
+void HostData_DefineSpecialFCode(const char* code)
+{
+    // Special friendly codes only matter for the data written by WriteHostData.
+    // Every run defines them, so counting them as a modification would mean every
+    // run rewrites the host data. Instead, keep them until HostData_Save() writes
+    // the data anyway; a run that modifies nothing does not need them.
+    for (size_t i = 0; i < gNumSpecialFCodes; ++i) {
+        if (strncmp(gSpecialFCodes[i], code, 3) == 0) {
+            return;
+        }
+    }
+    if (gNumSpecialFCodes >= MAX_SPECIAL_FCODES) {
+        ErrorExit("Too many special friendly codes");
+    }
+    strncpy(gSpecialFCodes[gNumSpecialFCodes], code, 3);
+    gSpecialFCodes[gNumSpecialFCodes][3] = '\0';
+    ++gNumSpecialFCodes;
+}
+
+unsigned HostData_Modified(void)
+{
+    return gModified;
+}
+
+enum HostDataSaveResult HostData_Save(void)
+{
+    if (gModified == 0) {
+        return HD_Unchanged;
+    }
+    for (size_t i = 0; i < gNumSpecialFCodes; ++i) {
+        DefineSpecialFCode(gSpecialFCodes[i]);
+    }
+    return WriteHostData() ? HD_Written : HD_Failed;
+}
+
+const char* HostData_Describe(char* buf, size_t size)
+{
+    size_t len = 0;
+    if (size > 0) {
+        buf[0] = '\0';
+    }
+    for (size_t i = 0; i < DIM(CLASS_NAMES); ++i) {
+        if ((gModified & CLASS_NAMES[i].Class) != 0) {
+            const char* sep = (len == 0 ? "" : ", ");
+            int n = snprintf(buf + len, size - len, "%s%s", sep, CLASS_NAMES[i].Name);
+            if (n < 0 || (size_t) n >= size - len) {
+                break;
+            }
+            len += n;
+        }
+    }
+    return buf;
+}
@@ -0,0 +1,131 @@
+/**
+  *  \file hostdata.h
+  *  \brief Starbase Reloaded - Host Data Modification Tracking
+  *
+  *  All modifications of host data go through these functions.
+  *  They forward to the PDK, and record which kind of data was modified,
+  *  so that we can avoid rewriting the host data if nothing changed.
+  *
+  *  Special friendly codes are not a modification of their own.
+  *  They are collected, and registered with the PDK only when the host data
+  *  is actually written by HostData_Save().
+  */
+#ifndef HOSTDATA_H_INCLUDED
+#define HOSTDATA_H_INCLUDED
+
+#include <stddef.h>
+#include <phostpdk.h>
+
+/** Classes of host data. Values are bits. */
+enum HostDataClass {
+    HD_Planets    = 1,
+    HD_Bases      = 2,
+    HD_Ships      = 4,
+    HD_Minefields = 8,
+    HD_Messages   = 16,
+    HD_UtilRecords = 32
+};
+
+/** Result of HostData_Save(). */
+enum HostDataSaveResult {
+    HD_Unchanged,             /**< Nothing was modified; host data not written. */
+    HD_Written,               /**< Host data written successfully. */
+    HD_Failed                 /**< WriteHostData failed. */
+};
+
+/** Set planet cargo (PutPlanetCargo). Records HD_Planets.
+    @param planetId Planet Id
+    @param type     Cargo type
+    @param amount   New amount */
+void HostData_PutPlanetCargo(Uns16 planetId, CargoType_Def type, Uns32 amount);
+
+/** Set starbase torpedo storage (PutBaseTorps). Records HD_Bases.
+    @param planetId Planet Id
+    @param torpNr   Torpedo type
+    @param amount   New amount */
+void HostData_PutBaseTorps(Uns16 planetId, Uns16 torpNr, Uns16 amount);
+
+/** Set starbase engine storage (PutBaseEngines). Records HD_Bases.
+    @param planetId Planet Id
+    @param slot     Engine type
+    @param amount   New amount */
+void HostData_PutBaseEngines(Uns16 planetId, Uns16 slot, Uns16 amount);
+
+/** Set starbase beam storage (PutBaseBeams). Records HD_Bases.
+    @param planetId Planet Id
+    @param slot     Beam type
+    @param amount   New amount */
+void HostData_PutBaseBeams(Uns16 planetId, Uns16 slot, Uns16 amount);
+
+/** Set starbase launcher storage (PutBaseTubes). Records HD_Bases.
+    @param planetId Planet Id
+    @param slot     Launcher type
+    @param amount   New amount */
+void HostData_PutBaseTubes(Uns16 planetId, Uns16 slot, Uns16 amount);
+
+/** Set ship cargo (PutShipCargo). Records HD_Ships.
+    @param shipId Ship Id
+    @param type   Cargo type
+    @param amount New amount */
+void HostData_PutShipCargo(Uns16 shipId, CargoType_Def type, Uns16 amount);
+
+/** Set ship ammunition (PutShipAmmunition). Records HD_Ships.
+    @param shipId Ship Id
+    @param amount New number of torpedoes or fighters */
+void HostData_PutShipAmmunition(Uns16 shipId, Uns16 amount);
+
+/** Set ship name (PutShipName). Records HD_Ships.
+    @param shipId Ship Id
+    @param name   New name */
+void HostData_PutShipName(Uns16 shipId, const char* name);
+
+/** Set minefield units (PutMinefieldUnits). Records HD_Minefields.
+    @param mineId Minefield Id
+    @param units  New number of units */
+void HostData_PutMinefieldUnits(Uns16 mineId, Uns32 units);
+
+/** Create minefield (CreateMinefield). Records HD_Minefields if a minefield was created.
+    @param x      X coordinate
+    @param y      Y coordinate
+    @param owner  Owner
+    @param units  Number of units
+    @param isWeb  True for a web minefield
+    @return Minefield Id; 0 on failure */
+Uns16 HostData_CreateMinefield(Uns16 x, Uns16 y, RaceType_Def owner, Uns32 units, Boolean isWeb);
+
+/** Send a message (WriteAUXHOSTMessage). Records HD_Messages.
+    @param to   Receiver
+    @param text Message text */
+void HostData_WriteMessage(RaceType_Def to, const char* text);
+
+/** Write a util.dat record (PutUtilRecordSimple). Records HD_UtilRecords.
+    @param to   Receiver
+    @param type Record type
+    @param size Size of data in bytes
+    @param data Record data */
+void HostData_PutUtilRecord(RaceType_Def to, Uns16 type, Uns16 size, const void* data);
+
+/** Define a special friendly code.
+    Does not record a HostDataClass bit; the code is registered with the PDK
+    (DefineSpecialFCode) by HostData_Save(), if that writes the host data.
+    @param code Friendly code (null-terminated) */
+void HostData_DefineSpecialFCode(const char* code);
+
+
+/** Get modified data classes.
+    @return Combination of HostDataClass values; 0 if nothing was modified */
+unsigned HostData_Modified(void);
+
+/** Save host data.
+    If nothing was modified, does nothing.
+    Otherwise, registers the special friendly codes and calls WriteHostData.
+    @return result */
+enum HostDataSaveResult HostData_Save(void);
+
+/** Describe modified data classes.
+    @param [out] buf  Buffer
+    @param [in]  size Size of buffer
+    @return buf, containing a comma-separated list of modified classes */
+const char* HostData_Describe(char* buf, size_t size);
+
+#endif
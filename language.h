@@ -51,6 +51,15 @@ struct Language {
     const char* ReportShip_Header;
     const char* ReportShip_Continuation;
 
+    // Parts lost on a ship that was renamed, captured or rebuilt
+    const char* ReportDiscarded_Header;
+    const char* ReportDiscarded_Continuation;
+
+    // Fleet manifest (TransportDigest)
+    const char* ReportDigest_Header;
+    const char* ReportDigest_Continuation;
+    const char* ReportDigest_Ship;
+
     const char* Continuation;
 };
 
@@ -20,8 +20,14 @@
 #include <string.h>
 #include "config.h"
 #include "credits.h"
+#include "hostdata.h"
+#include "message.h"
 #include "mine.h"
+#include "prescan.h"
+#include "profile.h"
 #include "sendconf.h"
+#include "snapshot.h"
+#include "statefile.h"
 #include "transport.h"
 
 static const char*const VERSION = "0.44";
@@ -29,6 +35,9 @@ static const char*const VERSION = "0.44";
 static const char*const BANNER = "Starbase Reloaded - A StarbasePlus Variant";
 static const char*const LOG_FILE = "psbplus.log";
 
+/* Game snapshot. Too large for the stack. */
+static struct Snapshot gSnapshot;
+
 enum Mode {
     BeforeMovement,
     AfterMovement,
@@ -78,10 +87,17 @@ static int ParseMode(enum Mode* pMode, const char* name)
     }
 }
 
-static void InitHostAction(Boolean beforeMovement, struct Config* c)
+static Boolean InitHostAction(Boolean beforeMovement, struct Config* c, struct Snapshot* s)
 {
     InitPHOSTLib();
     gLogFile = OpenOutputFile(LOG_FILE, GAME_DIR_ONLY | TEXT_MODE | (beforeMovement ? 0 : APPEND_MODE));
+    Config_Load(c);
+    if (c->SkipIdleTurns && Prescan_IsIdle(beforeMovement, c)) {
+        Info("Starbase Reloaded v%s - nothing to do.", VERSION);
+        FreePHOSTLib();
+        return False;
+    }
+
     Info("Loading...");
     if (!ReadGlobalData()) {
         FreePHOSTLib();
@@ -91,20 +107,38 @@ static void InitHostAction(Boolean beforeMovement, struct Config* c)
         FreePHOSTLib();
         ErrorExit("Unable to read host data");
     }
-    Config_Load(c);
+    Snapshot_Load(s);
+    Profiles_Build(&s->Profiles, s, c);
 
     // Set util.tmp mode. This causes our util.dat records come out in the right order.
     // In particular, our mine scans come out before PHost's.
     SetUtilMode(UTIL_Tmp);
+    return True;
 }
 
-static void DoneHostAction()
+static void DoneHostAction(struct Snapshot* s)
 {
-    Info("Saving...");
-    if (!WriteHostData()) {
+    Message_Flush();
+    Snapshot_Commit(s);
+    if (HostData_Modified() == 0) {
+        Info("No changes, not saving.");
+    } else {
+        char what[100];
+        Info("Saving (%s)...", HostData_Describe(what, sizeof(what)));
+    }
+    if (HostData_Save() == HD_Failed) {
+        // Keep the old state file; it matches the old host data.
+        StateFile_Discard();
         FreePHOSTLib();
         ErrorExit("Unable to write host data");
     }
+
+    // Replace state files only after host data has been written successfully,
+    // so that a failed write leaves both at their previous version.
+    if (!StateFile_Commit()) {
+        FreePHOSTLib();
+        ErrorExit("Unable to write state file");
+    }
     FreePHOSTLib();
 }
 
@@ -115,14 +149,17 @@ static void DoneHostAction()
 static void DoBeforeMovement()
 {
     struct Config c;
-    InitHostAction(True, &c);
+    struct Snapshot* s = &gSnapshot;
+    if (!InitHostAction(True, &c, s)) {
+        return;
+    }
 
     Info("Starbase Reloaded v%s - Before Movement...", VERSION);
-    DoMineSweeping(&c);
-    DoMineLaying(&c);
-    DoTrimCargo(&c);
+    DoMineSweeping(s, &c);
+    DoMineLaying(s, &c);
+    DoTrimCargo(s, &c);
 
-    DoneHostAction();
+    DoneHostAction(s);
 }
 
 /*
@@ -132,14 +169,17 @@ static void DoBeforeMovement()
 static void DoAfterMovement()
 {
     struct Config c;
-    InitHostAction(False, &c);
+    struct Snapshot* s = &gSnapshot;
+    if (!InitHostAction(False, &c, s)) {
+        return;
+    }
 
     Info("Starbase Reloaded v%s - After Movement...", VERSION);
-    DoComponentTransport(&c);
-    DoCreditTransfer(&c);
-    DoSendConfig(&c);
+    DoComponentTransport(s, &c);
+    DoCreditTransfer(s, &c);
+    DoSendConfig(s, &c);
 
-    DoneHostAction();
+    DoneHostAction(s);
 }
 
 /*
@@ -177,20 +217,19 @@ static void ShowComponents(const struct TransportShip* sh, const char* pfx, Base
 static void DoDumpShips()
 {
     struct TransportState st;
-    TransportState_Load(&st);
+    TransportState_Load(&st, TP_None);
 
-    struct TransportShip* sh;
     Uns16 count = 0;
-    for (Uns16 shipId = 1; (sh = TransportState_Ship(&st, shipId)) != NULL; ++shipId) {
-        if (TransportShip_HasComponents(sh)) {
-            printf("Ship %d:\n", shipId);
-            ShowComponents(sh, "  Engines:   ", ENGINE_TECH, ENGINE_NR);
-            ShowComponents(sh, "  Beams:     ", BEAM_TECH, BEAM_NR);
-            ShowComponents(sh, "  Torpedoes: ", TORP_TECH, TORP_NR);
-            ++count;
-        }
+    for (Uns16 shipId = TransportState_Next(&st, 0); shipId != 0; shipId = TransportState_Next(&st, shipId)) {
+        const struct TransportShip* sh = TransportState_Find(&st, shipId);
+        printf("Ship %d:\n", shipId);
+        ShowComponents(sh, "  Engines:   ", ENGINE_TECH, ENGINE_NR);
+        ShowComponents(sh, "  Beams:     ", BEAM_TECH, BEAM_NR);
+        ShowComponents(sh, "  Torpedoes: ", TORP_TECH, TORP_NR);
+        ++count;
     }
     printf("Found %d special transports.\n", count);
+    TransportState_Free(&st);
 }
 
 /*
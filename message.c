@@ -3,35 +3,264 @@
   *  \brief Starbase Reloaded - Messages
   */
 
-#include <assert.h>
+#include <stdlib.h>
 #include <string.h>
 #include "message.h"
+#include "hostdata.h"
 #include "language.h"
+#include "util.h"
+
+/* Ship name prefix to hide, see Message_SetHiddenShipPrefix(). */
+static const char* gHiddenShipPrefix = NULL;
+
+/*
+ *  Outbox
+ *
+ *  Messages are not written when sent, but collected here,
+ *  and written by Message_Flush() at the end of the run.
+ */
+
+/* Queued message. */
+struct OutboxEntry {
+    RaceType_Def To;                    /* Receiver. */
+    size_t Sequence;                    /* Order of submission. */
+    size_t HeaderLength;                /* Length of first line, without line break. */
+    struct Message Text;                /* Message text. */
+    struct Message Continuation;        /* Header for continuation pages; empty to repeat the first line. */
+};
+
+static struct OutboxEntry* gOutbox = NULL;
+static size_t gOutboxSize = 0;
+static size_t gOutboxCapacity = 0;
+
+/* Message page being assembled by Message_Flush(). */
+struct Page {
+    RaceType_Def To;                    /* Receiver. */
+    const struct OutboxEntry* Group;    /* Entry that started this page; NULL if page is not open for packing. */
+    size_t Length;                      /* Number of characters. */
+    size_t Lines;                       /* Number of lines. */
+    char Content[MAX_MESSAGE_LENGTH];   /* Character buffer; one byte reserved for terminator. */
+};
+
+static void Message_Free(struct Message* m)
+{
+    free(m->Content);
+    Message_Init(m);
+}
+
+/* Length of first line of text, without its line break. */
+static size_t GetHeaderLength(const char* text, size_t length)
+{
+    const char* eol = (length != 0 ? memchr(text, 13, length) : NULL);
+    return (eol != NULL ? (size_t) (eol - text) : length);
+}
+
+/* Number of lines in a piece of text. An unterminated last line counts as a line. */
+static size_t CountLines(const char* text, size_t length)
+{
+    size_t result = 0;
+    for (size_t i = 0; i < length; ++i) {
+        if (text[i] == 13) {
+            ++result;
+        }
+    }
+    if (length != 0 && text[length-1] != 13) {
+        ++result;
+    }
+    return result;
+}
+
+/* Check whether text of the given size fits on a page. */
+static Boolean Page_Fits(const struct Page* p, size_t length, size_t lines)
+{
+    const size_t separator = (p->Length != 0 && p->Content[p->Length-1] != 13);
+    return p->Length + separator + length <= MAX_MESSAGE_LENGTH-1
+        && p->Lines + lines <= MAX_MESSAGE_LINES;
+}
+
+/* Add text to a page, starting on a new line. Excess characters are discarded. */
+static void Page_Append(struct Page* p, const char* text, size_t length)
+{
+    if (p->Length != 0 && p->Content[p->Length-1] != 13 && p->Length < MAX_MESSAGE_LENGTH-1) {
+        p->Content[p->Length++] = 13;
+    }
+    const size_t n = MIN(length, MAX_MESSAGE_LENGTH-1 - p->Length);
+    memcpy(&p->Content[p->Length], text, n);
+    p->Length += n;
+    p->Lines += CountLines(text, n);
+}
+
+/* Write a page, if any, and reset it. */
+static void Page_Send(struct Page* p)
+{
+    if (p->Length != 0) {
+        p->Content[p->Length] = '\0';
+        HostData_WriteMessage(p->To, p->Content);
+    }
+    p->Group = NULL;
+    p->Length = 0;
+    p->Lines = 0;
+}
+
+/* Write a message that does not fit on one page.
+   Each page but the last ends with the Continuation line; each page but the first starts with the continuation header. */
+static void Page_SendLong(struct Page* p, const struct OutboxEntry* e)
+{
+    const char* text = e->Text.Content;
+    const size_t length = e->Text.Length;
+
+    struct Message marker;
+    Message_Init(&marker);
+    Message_Add(&marker, GetLanguageForPlayer(e->To)->Continuation);
+
+    size_t pos = 0;
+    while (pos < length) {
+        p->To = e->To;
+        if (pos != 0) {
+            if (e->Continuation.Length != 0) {
+                Page_Append(p, e->Continuation.Content, e->Continuation.Length);
+            } else {
+                Page_Append(p, text, MIN(e->HeaderLength + 1, length));
+            }
+        }
+
+        if (Page_Fits(p, length - pos, CountLines(&text[pos], length - pos))) {
+            // Remainder fits
+            Page_Append(p, &text[pos], length - pos);
+            pos = length;
+        } else {
+            // Fill page line by line, leaving room for the continuation line
+            const size_t start = pos;
+            while (pos < length) {
+                const char* eol = memchr(&text[pos], 13, length - pos);
+                const size_t n = (eol != NULL ? (size_t) (eol - &text[pos]) + 1 : length - pos);
+                if (!Page_Fits(p, n + marker.Length, CountLines(&text[pos], n) + marker.Lines)) {
+                    break;
+                }
+                Page_Append(p, &text[pos], n);
+                pos += n;
+            }
+            if (pos == start) {
+                // Not even one line fits; cut it at the byte limit.
+                const size_t used = p->Length + 1 + marker.Length;
+                const size_t n = (used < MAX_MESSAGE_LENGTH-1 ? MAX_MESSAGE_LENGTH-1 - used : 1);
+                Page_Append(p, &text[pos], MIN(n, length - pos));
+                pos += MIN(n, length - pos);
+            }
+            Page_Append(p, marker.Content, marker.Length);
+        }
+        Page_Send(p);
+    }
+    Message_Free(&marker);
+}
+
+/* Outbox sort order: receiver, then submission order. */
+static int CompareOutboxEntries(const void* pa, const void* pb)
+{
+    const struct OutboxEntry* a = pa;
+    const struct OutboxEntry* b = pb;
+    if (a->To != b->To) {
+        return a->To < b->To ? -1 : 1;
+    }
+    return a->Sequence < b->Sequence ? -1 : a->Sequence > b->Sequence ? 1 : 0;
+}
 
+/* Check whether two entries belong on the same page. */
+static Boolean IsSameGroup(const struct OutboxEntry* a, const struct OutboxEntry* b)
+{
+    return a->To == b->To
+        && a->HeaderLength == b->HeaderLength
+        && memcmp(a->Text.Content, b->Text.Content, a->HeaderLength) == 0;
+}
+
+void Message_Flush(void)
+{
+    if (gOutboxSize != 0) {
+        qsort(gOutbox, gOutboxSize, sizeof(*gOutbox), CompareOutboxEntries);
+    }
+
+    static struct Page page;
+    page.Group = NULL;
+    page.Length = 0;
+    page.Lines = 0;
+    for (size_t i = 0; i < gOutboxSize; ++i) {
+        const struct OutboxEntry* e = &gOutbox[i];
+        const char* text = e->Text.Content;
+        const size_t length = e->Text.Length;
+        if (length > MAX_MESSAGE_LENGTH-1 || CountLines(text, length) > MAX_MESSAGE_LINES) {
+            // Long message: gets pages of its own
+            Page_Send(&page);
+            Page_SendLong(&page, e);
+        } else {
+            // Short message: if it has the same header as the previous message,
+            // pack everything after the header line onto the current page if possible
+            const size_t bodyStart = MIN(e->HeaderLength + 1, length);
+            const size_t bodyLength = length - bodyStart;
+            if (page.Group == NULL
+                || !IsSameGroup(page.Group, e)
+                || !Page_Fits(&page, bodyLength, CountLines(&text[bodyStart], bodyLength)))
+            {
+                Page_Send(&page);
+                page.To = e->To;
+                page.Group = e;
+                Page_Append(&page, text, length);
+            } else {
+                Page_Append(&page, &text[bodyStart], bodyLength);
+            }
+        }
+    }
+    Page_Send(&page);
+
+    for (size_t i = 0; i < gOutboxSize; ++i) {
+        Message_Free(&gOutbox[i].Text);
+        Message_Free(&gOutbox[i].Continuation);
+    }
+    free(gOutbox);
+    gOutbox = NULL;
+    gOutboxSize = 0;
+    gOutboxCapacity = 0;
+}
+
+
+/*
+ *  Message Building
+ */
 
 void Message_Init(struct Message* m)
 {
     m->Length = 0;
     m->Lines = 0;
+    m->Capacity = 0;
+    m->Content = NULL;
 }
 
 void Message_AddChar(struct Message* m, char ch)
 {
-    if (m->Length < MAX_MESSAGE_LENGTH-1) {
-        if (ch == '\n') {
-            // Newline transmitted as \r (13) in VGAP
-            ++m->Lines;
-            m->Content[m->Length] = 13;
-            ++m->Length;
-        } else if ((unsigned char) ch > 255-13) {
-            // These characters cannot be handled by ROT-13 encryption; discard.
-            // They can possibly appear in user-provided names.
-        } else {
-            // Normal case
-            m->Content[m->Length] = ch;
-            ++m->Length;
+    if ((unsigned char) ch > 255-13) {
+        // These characters cannot be handled by ROT-13 encryption; discard.
+        // They can possibly appear in user-provided names.
+        return;
+    }
+
+    if (m->Length >= m->Capacity) {
+        const size_t newCapacity = (m->Capacity != 0 ? 2*m->Capacity : MAX_MESSAGE_LENGTH);
+        char* newContent = realloc(m->Content, newCapacity);
+        if (newContent == NULL) {
+            ErrorExit("Out of memory");
         }
+        m->Content = newContent;
+        m->Capacity = newCapacity;
     }
+
+    if (ch == '\n') {
+        // Newline transmitted as \r (13) in VGAP
+        ++m->Lines;
+        m->Content[m->Length] = 13;
+    } else {
+        // Normal case
+        m->Content[m->Length] = ch;
+    }
+    ++m->Length;
 }
 
 void Message_Add(struct Message* m, const char* str)
@@ -93,7 +322,12 @@ void Message_Format(struct Message* m, const char* tpl, const Uns32* args, size_
                 // Ship name
                 if (index < numArgs) {
                     ShipName(args[index], tmp);
-                    Message_Add(m, tmp);
+                    const size_t prefixLength = (gHiddenShipPrefix != NULL ? strlen(gHiddenShipPrefix) : 0);
+                    if (prefixLength != 0 && strncmp(tmp, gHiddenShipPrefix, prefixLength) == 0) {
+                        Message_Add(m, &tmp[prefixLength]);
+                    } else {
+                        Message_Add(m, tmp);
+                    }
                 }
                 break;
             }
@@ -103,11 +337,60 @@ void Message_Format(struct Message* m, const char* tpl, const Uns32* args, size_
     }
 }
 
+void Message_FormatHeader(struct Message* m, const char* tpl, const Uns32* args, size_t numArgs)
+{
+    const size_t start = m->Length;
+    const size_t lines = m->Lines;
+    Message_Format(m, tpl, args, numArgs);
+
+    const size_t n = GetHeaderLength(&m->Content[start], m->Length - start);
+    if (start + n < m->Length) {
+        m->Length = start + n + 1;
+        m->Lines = lines + 1;
+    }
+}
+
+void Message_SetHiddenShipPrefix(const char* prefix)
+{
+    gHiddenShipPrefix = prefix;
+}
+
 void Message_Send(struct Message* m, RaceType_Def to)
 {
-    assert(m->Length < sizeof(m->Content));
-    m->Content[m->Length] = '\0';
-    WriteAUXHOSTMessage(to, m->Content);
+    struct Message cont;
+    Message_Init(&cont);
+    Message_SendContinued(m, &cont, to);
+}
+
+void Message_SendContinued(struct Message* m, struct Message* cont, RaceType_Def to)
+{
+    if (m->Length == 0) {
+        Message_Free(m);
+        Message_Free(cont);
+        return;
+    }
+
+    if (gOutboxSize >= gOutboxCapacity) {
+        const size_t newCapacity = (gOutboxCapacity != 0 ? 2*gOutboxCapacity : 64);
+        struct OutboxEntry* newOutbox = realloc(gOutbox, newCapacity * sizeof(*gOutbox));
+        if (newOutbox == NULL) {
+            ErrorExit("Out of memory");
+        }
+        gOutbox = newOutbox;
+        gOutboxCapacity = newCapacity;
+    }
+
+    struct OutboxEntry* e = &gOutbox[gOutboxSize];
+    e->To = to;
+    e->Sequence = gOutboxSize;
+    e->HeaderLength = GetHeaderLength(m->Content, m->Length);
+    e->Text = *m;
+    e->Continuation = *cont;
+    ++gOutboxSize;
+
+    // Ownership of the buffers has been transferred
+    Message_Init(m);
+    Message_Init(cont);
 }
 
 void Message_SendTemplate(RaceType_Def to, const char* tpl, const Uns32* args, size_t numArgs)
@@ -10,10 +10,10 @@
 /** Maxium message length in bytes. */
 #define MAX_MESSAGE_LENGTH 600
 
-/** Estimated maximum number of message lines.
-    This is not a hard limit; code generating variable-length messages
-    uses this as a guideline when to start a new message. */
-#define MAX_MESSAGE_LINES 17
+/** Maximum number of lines per message page.
+    Longer messages are split into multiple pages by Message_Flush();
+    this limit includes the continuation line. */
+#define MAX_MESSAGE_LINES 18
 
 
 /*
@@ -21,20 +21,23 @@
  */
 
 /** Message building state.
-    Tracks content and size for a message. */
+    Tracks content and size for a message.
+    A message can be longer than MAX_MESSAGE_LENGTH; it is split into pages when sent. */
 struct Message {
     size_t Length;                        /**< Number of characters so far. */
     size_t Lines;                         /**< Number of lines so far. */
-    char Content[MAX_MESSAGE_LENGTH];     /**< Character buffer. */
+    size_t Capacity;                      /**< Size of Content buffer. */
+    char* Content;                        /**< Character buffer, allocated with malloc(); NULL if nothing added yet. */
 };
 
 /** Initialize a message.
+    This does not allocate memory;
+    memory is allocated when the first character is added, and released by Message_Send.
     @param [out] m Structure to initialize */
 void Message_Init(struct Message* m);
 
 /** Add character to e message.
     Counts lines and characters.
-    If the character limit is exceeded, excess characters are discarded.
     @param [in,out] m  Message
     @param [in]     ch Character to add */
 void Message_AddChar(struct Message* m, char ch);
@@ -55,7 +58,7 @@ void Message_Add(struct Message* m, const char* str);
     - 'd' integer
     - 'A' race name adjective
     - 'P' planet name
-    - 'S' ship name
+    - 'S' ship name (see Message_SetHiddenShipPrefix)
 
     Also see Message_AddChar.
 
@@ -65,11 +68,42 @@ void Message_Add(struct Message* m, const char* str);
     @param [in]     numArgs Number of parameters (number of elements in args) */
 void Message_Format(struct Message* m, const char* tpl, const Uns32* args, size_t numArgs);
 
+/** Add formatted header line to a message.
+    Like Message_Format, but adds only the first line of the template.
+    Use this to start a message that Message_Flush() shall pack onto the same page
+    as the immediately preceding message with the same header.
+    @param [in,out] m       Message
+    @param [in]     tpl     Message template
+    @param [in]     args    Parameters
+    @param [in]     numArgs Number of parameters (number of elements in args) */
+void Message_FormatHeader(struct Message* m, const char* tpl, const Uns32* args, size_t numArgs);
+
+/** Set ship name prefix to hide.
+    While set, ship names starting with this prefix are formatted without it.
+    @param [in] prefix Prefix; NULL or empty to show names unchanged */
+void Message_SetHiddenShipPrefix(const char* prefix);
+
 /** Send message.
-    @param [in] in Message
-    @param [in] to Player to receive the message */
+    The message is queued in the receiver's outbox and written by Message_Flush().
+    If it does not fit on one page, continuation pages repeat its first line.
+    @param [in,out] m  Message; consumed and re-initialized
+    @param [in]     to Player to receive the message */
 void Message_Send(struct Message* m, RaceType_Def to);
 
+/** Send message with continuation header.
+    Like Message_Send, but continuation pages start with the given header.
+    @param [in,out] m    Message; consumed and re-initialized
+    @param [in,out] cont Header for continuation pages; consumed and re-initialized
+    @param [in]     to   Player to receive the message */
+void Message_SendContinued(struct Message* m, struct Message* cont, RaceType_Def to);
+
+/** Write all queued messages.
+    Processes the outbox in one pass, sorted by receiver; each player's messages keep their order.
+    Consecutive short messages with identical header line are packed onto one page;
+    long messages are split into pages at the MAX_MESSAGE_LENGTH and MAX_MESSAGE_LINES limits,
+    using the receiver's Continuation line. */
+void Message_Flush(void);
+
 
 /*
  *  Higher-Level Functions
@@ -3,19 +3,16 @@
   *  \brief Starbase Reloaded - Mine Laying and Sweeping
   */
 
+#include <stdlib.h>
 #include <phostpdk.h>
 #include "mine.h"
 #include "config.h"
+#include "fcode.h"
 #include "message.h"
+#include "snapshot.h"
 #include "util.h"
 #include "utildata.h"
 
-/* With this option set, we try to reproduce psbplus behaviour more closely:
-   torpedo-to-mine uses tech-squared, not slot-squared.
-   Slot-squared is more consistent with the rest of the game, and seems to be
-   what the original documentation (STARBASE.TXT) implies. */
-static const Boolean USE_TORP_TECH = False;
-
 /* Maximum number of torpedoes in base storage.
    PHost seems to put the limit at 32767, but many others (including HOST, c2ng) put it at 10000.
    This should still be more than enough. */
@@ -26,133 +23,112 @@ static const Uns16 MAX_BASE_TORPS = 10000;
  *  Mine Laying
  */
 
-static Uns32 UnitsPerTorpedoRate(const struct Config* c, RaceType_Def owner, Uns16 torpNr, Boolean isWeb)
+static Uns32 OwnerMask(RaceType_Def owner)
 {
-    (void) c;
-
-    if (USE_TORP_TECH) {
-        torpNr = TorpTechLevel(torpNr);
-    }
-
-    Uns32 rate = torpNr * torpNr;
-
-    if (owner > 0 && owner <= RACE_NR) {
-        Uns16 playerRate = (isWeb
-                            ? gPconfigInfo->UnitsPerWebRate[owner]
-                            : gPconfigInfo->UnitsPerTorpRate[owner]);
-
-        rate = rate * playerRate / 100;
-    }
-
-    return MAX(rate, 1);
-}
-
-static Uns32 MaxMinefieldUnits(RaceType_Def owner, Boolean isWeb)
-{
-    Uns32 maxRadius = isWeb
-        ? gPconfigInfo->MaximumWebMinefieldRadius[owner]
-        : gPconfigInfo->MaximumMinefieldRadius[owner];
-
-    return maxRadius*maxRadius;
+    return (owner > 0 && owner <= RACE_NR) ? (Uns32) (1UL << owner) : 0;
 }
 
-static Uns16 FindMinefieldForLaying(Uns16 planetId, RaceType_Def owner, Boolean isWeb)
+static Uns16 FindMinefieldForLaying(const struct Snapshot* s, Uns16 planetId, RaceType_Def owner, Boolean isWeb)
 {
-    const Uns16* candidates = EnumerateMinesCovering(PlanetLocationX(planetId), PlanetLocationY(planetId));
+    Uns16 candidates[MINE_NR+1];
+    Snapshot_EnumerateMinesCovering(s, s->Planets.X[planetId], s->Planets.Y[planetId], OwnerMask(owner), candidates);
     for (size_t i = 0; candidates[i] != 0; ++i) {
         const Uns16 cand = candidates[i];
-        if (MinefieldOwner(cand) == owner && IsMinefieldWeb(cand) == isWeb) {
+        if (s->Minefields.Owner[cand] == owner && s->Minefields.IsWeb[cand] == isWeb) {
             return cand;
         }
     }
     return 0;
 }
 
-static Uns32 UnitsToLay(const struct Config* c, RaceType_Def owner, Boolean isWeb, Uns32 existingUnits, Uns16 torpNr, Uns16 torps)
+static Uns32 UnitsToLay(Uns32 permittedUnits, Uns32 rate, Uns32 existingUnits, Uns16 torps)
 {
     // Maximum number that can be added without exceeding the maximum size:
-    const Uns32 permittedUnits = MaxMinefieldUnits(owner, isWeb);
     const Uns32 addibleUnits = existingUnits < permittedUnits ? permittedUnits - existingUnits : 0;
 
     // Units we add now
-    const Uns32 rate = UnitsPerTorpedoRate(c, owner, torpNr, isWeb);
     return MIN(torps * rate, addibleUnits);
 }
 
-static void RemoveTorpedoes(const struct Config* c, Uns16 planetId, Uns16 torpNr, Boolean isWeb, Uns32 unitsNow)
+static void RemoveTorpedoes(struct Snapshot* s, Uns16 planetId, Uns16 torpNr, Uns32 rate, Uns32 unitsNow)
 {
     // If a fractional torpedo was laid, remove it entirely.
-    const Uns32 rate = UnitsPerTorpedoRate(c, PlanetOwner(planetId), torpNr, isWeb);
-    const Uns16 torps = BaseTorps(planetId, torpNr) - (unitsNow + (rate-1)) / rate;
+    const Uns16 torps = s->Bases.Torps[planetId][torpNr-1] - (unitsNow + (rate-1)) / rate;
 
-    PutBaseTorps(planetId, torpNr, torps);
+    Snapshot_PutBaseTorps(s, planetId, torpNr, torps);
 }
 
-static void LayMinefield(const struct Config* c, Uns16 planetId, RaceType_Def owner, Boolean isWeb)
+static void LayMinefield(struct Snapshot* s, Uns16 planetId, RaceType_Def owner, Boolean isWeb)
 {
+    const Uns32 permittedUnits = Profiles_MaxMineUnits(&s->Profiles, owner, isWeb);
     Uns16 mineId = 0;
     Uns32 unitsLaid = 0;
     for (Uns16 torpNr = TORP_NR; torpNr >= 1; --torpNr) {
-        Uns16 torps = BaseTorps(planetId, torpNr);
+        Uns16 torps = s->Bases.Torps[planetId][torpNr-1];
         if (torps > 0) {
+            const Uns32 rate = Profiles_UnitsPerTorp(&s->Profiles, owner, torpNr, isWeb);
+
             // Locate minefield
             if (mineId == 0) {
-                mineId = FindMinefieldForLaying(planetId, owner, isWeb);
+                mineId = FindMinefieldForLaying(s, planetId, owner, isWeb);
             }
             if (mineId != 0) {
                 // We have an existing minefield. Enlarge it if possible.
-                const Uns32 existingUnits = MinefieldUnits(mineId);
-                const Uns32 unitsNow = UnitsToLay(c, owner, isWeb, existingUnits, torpNr, torps);
+                const Uns32 existingUnits = s->Minefields.Units[mineId];
+                const Uns32 unitsNow = UnitsToLay(permittedUnits, rate, existingUnits, torps);
 
                 // Enlarge minefield
-                PutMinefieldUnits(mineId, existingUnits + unitsNow);
+                Snapshot_PutMinefieldUnits(s, mineId, existingUnits + unitsNow);
                 unitsLaid += unitsNow;
 
-                RemoveTorpedoes(c, planetId, torpNr, isWeb, unitsNow);
+                RemoveTorpedoes(s, planetId, torpNr, rate, unitsNow);
             } else {
                 // No minefield there. Create one.
-                const Uns32 unitsNow = UnitsToLay(c, owner, isWeb, 0, torpNr, torps);
+                const Uns32 unitsNow = UnitsToLay(permittedUnits, rate, 0, torps);
 
-                mineId = CreateMinefield(PlanetLocationX(planetId), PlanetLocationY(planetId), owner, unitsNow, isWeb);
+                mineId = Snapshot_CreateMinefield(s, s->Planets.X[planetId], s->Planets.Y[planetId], owner, unitsNow, isWeb);
                 if (mineId == 0) {
                     Info("\t(-) Base %d, player %d: failure to lay minefield", planetId, owner);
                     break;
                 }
 
                 unitsLaid += unitsNow;
-                RemoveTorpedoes(c, planetId, torpNr, isWeb, unitsNow);
+                RemoveTorpedoes(s, planetId, torpNr, rate, unitsNow);
             }
         }
     }
 
     // Send message
     if (unitsLaid > 0 && mineId > 0) {
+        const struct SnapshotMinefields* m = &s->Minefields;
         Info("\t(+) Base %d, player %d, minefield %d: laid %d units", planetId, owner, mineId, (int) unitsLaid);
-        Message_MinefieldLaid(owner, planetId, mineId, MinefieldPositionX(mineId), MinefieldPositionY(mineId), unitsLaid, MinefieldUnits(mineId), MinefieldRadius(mineId), isWeb);
-        Util_Minefield(owner, mineId, MinefieldPositionX(mineId), MinefieldPositionY(mineId), MinefieldOwner(mineId), MinefieldUnits(mineId), IsMinefieldWeb(mineId), MINE_LAID);
+        Message_MinefieldLaid(owner, planetId, mineId, m->X[mineId], m->Y[mineId], unitsLaid, m->Units[mineId], Snapshot_MinefieldRadius(s, mineId), isWeb);
+        Util_Minefield(owner, mineId, m->X[mineId], m->Y[mineId], m->Owner[mineId], m->Units[mineId], m->IsWeb[mineId], MINE_LAID);
     }
 }
 
-void DoMineLaying(const struct Config* c)
+void DoMineLaying(struct Snapshot* s, const struct Config* c)
 {
     if (c->LayMinefields || c->LayWebMinefields) {
         Info("    Laying minefields...");
-        for (Uns16 i = 1; i <= PLANET_NR; ++i) {
-            if (IsBaseExist(i)) {
-                RaceType_Def owner = PlanetOwner(i);
-                if (c->LayMinefields && PlanetHasFCode(i, "LMF")) {
-                    LayMinefield(c, i, owner, False);
+        const struct ScheduleList list = Schedule_Get(&s->Schedule, SS_MineLaying);
+        for (Uns16 n = 0; n < list.Count; ++n) {
+            const Uns16 i = list.Ids[n];
+            if (s->Bases.Exists[i]) {
+                RaceType_Def owner = s->Planets.Owner[i];
+                if (c->LayMinefields && s->Planets.Action[i] == FC_LayMines) {
+                    LayMinefield(s, i, owner, False);
                 }
-                if (c->LayWebMinefields && gPconfigInfo->PlayerSpecialMission[owner] == 7 && PlanetHasFCode(i, "LWF")) {
-                    LayMinefield(c, i, owner, True);
+                if (c->LayWebMinefields && gPconfigInfo->PlayerSpecialMission[owner] == 7 && s->Planets.Action[i] == FC_LayWebMines) {
+                    LayMinefield(s, i, owner, True);
                 }
             }
         }
         if (c->LayMinefields) {
-            DefineSpecialFCode("LMF");
+            FCode_DefineSpecial(FC_LayMines);
         }
         if (c->LayWebMinefields) {
-            DefineSpecialFCode("LWF");
+            FCode_DefineSpecial(FC_LayWebMines);
         }
     } else {
         Info("    Laying minefields disabled.");
@@ -163,36 +139,70 @@ void DoMineLaying(const struct Config* c)
  *  Sweeping/Scooping
  */
 
-static Uns32 BeamSweepCapacity(const struct Config* c, Uns16 planetId, Boolean isWeb)
+static Boolean PlanetSweepsMine(const struct Snapshot* s, Uns16 planetId, Uns16 mineId)
 {
-    // CHANGE: pstarbase divide by 20 last, but STARBASE.TXT says we do it here
-    Uns16 numBeams = BaseDefense(planetId) / 20;
-    Uns16 beamTech = BaseTech(planetId, BEAM_TECH);
-    Uns16 rate = isWeb ? c->BeamWebSweepRate : c->BeamSweepRate;
-
-    return (Uns32) rate * beamTech *  beamTech * numBeams;
+    return Alliances_MaySweep(&s->Alliances, s->Planets.Owner[planetId], s->Minefields.Owner[mineId]);
 }
 
-static Boolean PlanetSweepsMine(Uns16 planetId, Uns16 mineId)
+/* Kind of sweep demand */
+enum SweepKind {
+    SK_Beams,
+    SK_Fighters,
+    SK_Scoop
+};
+
+/* A base's demand against a single minefield. */
+struct SweepDemand {
+    Uns16 MineId;
+    Uns16 PlanetId;
+    Uns32 Capacity;               /* Units to sweep (for the field's type); unused for scooping. */
+    Uns32 Sequence;               /* Order in which demands were gathered. */
+    enum SweepKind Kind;
+};
+
+/* All demands of this turn. */
+struct SweepDemands {
+    struct SweepDemand* Items;
+    size_t Count;
+    size_t Capacity;
+};
+
+static void SweepDemands_Add(struct SweepDemands* d, Uns16 mineId, Uns16 planetId, Uns32 capacity, enum SweepKind kind)
 {
-    RaceType_Def planetOwner = PlanetOwner(planetId);
-    RaceType_Def mineOwner = MinefieldOwner(mineId);
-
-    if (planetOwner == mineOwner) {
-        return False;
+    if (d->Count >= d->Capacity) {
+        const size_t newCapacity = (d->Capacity == 0 ? 256 : 2*d->Capacity);
+        struct SweepDemand* newItems = realloc(d->Items, newCapacity * sizeof(*newItems));
+        if (newItems == NULL) {
+            ErrorExit("Out of memory");
+        }
+        d->Items = newItems;
+        d->Capacity = newCapacity;
     }
 
-    if (PlayersAreAllies(planetOwner, mineOwner)
-        && PlayerAllowsAlly(planetOwner, mineOwner, ALLY_MINES)
-        && PlayerAllowsAlly(mineOwner, planetOwner, ALLY_MINES))
-    {
-        return False;
-    }
+    struct SweepDemand* p = &d->Items[d->Count];
+    p->MineId = mineId;
+    p->PlanetId = planetId;
+    p->Capacity = capacity;
+    p->Sequence = d->Count;
+    p->Kind = kind;
+    ++d->Count;
+}
 
-    return True;
+static int CompareDemands(const void* a, const void* b)
+{
+    const struct SweepDemand* pa = a;
+    const struct SweepDemand* pb = b;
+    if (pa->MineId != pb->MineId) {
+        return pa->MineId < pb->MineId ? -1 : 1;
+    }
+    return (pa->Sequence > pb->Sequence) - (pa->Sequence < pb->Sequence);
 }
 
-static void SweepFromPlanet(Uns16 planetId, Uns32 mineCapacity, Uns32 webCapacity, Uns16 range, Boolean withFighters)
+/*
+ *  Phase 1: gather demands
+ */
+
+static void SweepFromPlanet(const struct Snapshot* s, struct SweepDemands* d, Uns16 planetId, Uns32 mineCapacity, Uns32 webCapacity, Uns16 range, enum SweepKind kind)
 {
     // No need to gather mines if rate is 0 (by base having too little defense or disabled)
     if (mineCapacity == 0 && webCapacity == 0) {
@@ -200,145 +210,189 @@ static void SweepFromPlanet(Uns16 planetId, Uns32 mineCapacity, Uns32 webCapacit
     }
 
     // Check candidates
-    const Uns16* candidates = EnumerateMinesWithinRadius(PlanetLocationX(planetId), PlanetLocationY(planetId), range);
+    Uns16 candidates[MINE_NR+1];
+    Snapshot_EnumerateMinesWithinRadius(s, s->Planets.X[planetId], s->Planets.Y[planetId], range,
+                                        Alliances_SweepMask(&s->Alliances, s->Planets.Owner[planetId]), candidates);
     for (size_t i = 0; candidates[i] != 0; ++i) {
         const Uns16 mineId = candidates[i];
-        if (PlanetSweepsMine(planetId, mineId)) {
-            // Capture old minefield state
-            const RaceType_Def oldOwner = MinefieldOwner(mineId);
-            const Uns16 oldX = MinefieldPositionX(mineId);
-            const Uns16 oldY = MinefieldPositionY(mineId);
-            const Uns16 oldRadius = MinefieldRadius(mineId);
-            const Boolean oldWeb = IsMinefieldWeb(mineId);
-
-            // Compute loss
-            const Uns32 existingUnits = MinefieldUnits(mineId);
-            const Uns32 capacity = oldWeb ? webCapacity : mineCapacity;
-            const Uns32 sweptUnits = MIN(existingUnits, capacity);
-            const Uns32 remainingUnits = existingUnits - sweptUnits;
-
-            PutMinefieldUnits(mineId, remainingUnits);
-
-            Info("\t(+) Base %d, minefield %d: sweep %ld units using %s", planetId, mineId, (long) sweptUnits, withFighters ? "fighters" : "beams");
-            Message_MinefieldSwept(PlanetOwner(planetId), planetId, mineId, oldX, oldY, oldOwner, oldRadius, sweptUnits, remainingUnits, oldWeb, withFighters);
-            Util_Minefield(PlanetOwner(planetId), mineId, oldX, oldY, oldOwner, remainingUnits, oldWeb, MINE_SWEPT);
+        if (PlanetSweepsMine(s, planetId, mineId)) {
+            SweepDemands_Add(d, mineId, planetId, s->Minefields.IsWeb[mineId] ? webCapacity : mineCapacity, kind);
         }
     }
 }
 
-static void SweepUsingBeams(const struct Config* c, Uns16 planetId)
+static void SweepUsingBeams(const struct Snapshot* s, struct SweepDemands* d, Uns16 planetId)
 {
-    SweepFromPlanet(planetId, BeamSweepCapacity(c, planetId, False), BeamSweepCapacity(c, planetId, True), c->BeamSweepRate, False);
+    const struct BaseProfile* b = &s->Profiles.Bases[planetId];
+    SweepFromPlanet(s, d, planetId, b->BeamMineCapacity, b->BeamWebCapacity, b->BeamRange, SK_Beams);
 }
 
-static void SweepUsingFighters(const struct Config* c, Uns16 planetId)
+static void SweepUsingFighters(const struct Snapshot* s, struct SweepDemands* d, Uns16 planetId)
 {
-    Uns32 mineCapacity, webCapacity;
-    Uns16 range;
-    if (gPconfigInfo->PlayerRace[PlanetOwner(planetId)] == Colonies) {
-        // Colonies: can always sweep mines with fighters; can sweep webs if configured in PCONFIG; always 100 ly range.
-        mineCapacity = c->FtrSweepRate;
-        webCapacity  = gPconfigInfo->ColSweepWebs ? c->FtrWebSweepRate : 0;
-        range = 100;
-    } else {
-        // Others: can sweep mines only if configured; can never sweep webs; dynamic range.
-        mineCapacity = c->ColonialFighterOnlySweepMines ? 0 : c->FtrSweepRate;
-        webCapacity = 0;
-        range = 10 * ((BaseTech(planetId, HULL_TECH) + BaseTech(planetId, ENGINE_TECH) + BaseTech(planetId, BEAM_TECH)) / 3);
-    }
-
-    mineCapacity *= BaseFighters(planetId);
-    webCapacity *= BaseFighters(planetId);
+    const struct BaseProfile* b = &s->Profiles.Bases[planetId];
+    SweepFromPlanet(s, d, planetId, b->FighterMineCapacity, b->FighterWebCapacity, b->FighterRange, SK_Fighters);
+}
 
-    SweepFromPlanet(planetId, mineCapacity, webCapacity, range, True);
+static Boolean PlanetScoopsMine(const struct Snapshot* s, Uns16 planetId, Uns16 mineId)
+{
+    return Alliances_MayScoop(&s->Alliances, s->Planets.Owner[planetId], s->Minefields.Owner[mineId]);
 }
 
-static Boolean PlanetScoopsMine(Uns16 planetId, Uns16 mineId)
+static void ScoopFromPlanet(const struct Snapshot* s, const struct Config* c, struct SweepDemands* d, Uns16 planetId)
 {
-    RaceType_Def planetOwner = PlanetOwner(planetId);
-    RaceType_Def mineOwner = MinefieldOwner(mineId);
+    Uns16 candidates[MINE_NR+1];
+    Snapshot_EnumerateMinesWithinRadius(s, s->Planets.X[planetId], s->Planets.Y[planetId], c->BeamSweepRange,
+                                        Alliances_ScoopMask(&s->Alliances, s->Planets.Owner[planetId]), candidates);
+    for (size_t i = 0; candidates[i] != 0; ++i) {
+        Uns16 mineId = candidates[i];
+        if (PlanetScoopsMine(s, planetId, mineId)) {
+            SweepDemands_Add(d, mineId, planetId, 0, SK_Scoop);
+        }
+    }
+}
 
-    return (planetOwner == mineOwner);
+/*
+ *  Phase 2: apply demands
+ */
+
+static void ApplySweep(struct Snapshot* s, const struct SweepDemand* p)
+{
+    const Uns16 mineId = p->MineId;
+    const Uns16 planetId = p->PlanetId;
+
+    // Capture old minefield state
+    const RaceType_Def oldOwner = s->Minefields.Owner[mineId];
+    const Uns16 oldX = s->Minefields.X[mineId];
+    const Uns16 oldY = s->Minefields.Y[mineId];
+    const Uns16 oldRadius = Snapshot_MinefieldRadius(s, mineId);
+    const Boolean oldWeb = s->Minefields.IsWeb[mineId];
+
+    // Compute loss
+    const Uns32 existingUnits = s->Minefields.Units[mineId];
+    const Uns32 sweptUnits = MIN(existingUnits, p->Capacity);
+    const Uns32 remainingUnits = existingUnits - sweptUnits;
+
+    Snapshot_PutMinefieldUnits(s, mineId, remainingUnits);
+
+    const Boolean withFighters = (p->Kind == SK_Fighters);
+    Info("\t(+) Base %d, minefield %d: sweep %ld units using %s", planetId, mineId, (long) sweptUnits, withFighters ? "fighters" : "beams");
+    Message_MinefieldSwept(s->Planets.Owner[planetId], planetId, mineId, oldX, oldY, oldOwner, oldRadius, sweptUnits, remainingUnits, oldWeb, withFighters);
 }
 
-static Uns16 TorpNrForScooping(Uns16 planetId)
+static void ApplyScoop(struct Snapshot* s, const struct SweepDemand* p)
 {
-    // We always scoop into the best torpedo slot the base can build.
-    Uns16 torpTech = BaseTech(planetId, TORP_TECH);
-    Uns16 torpNr = TORP_NR;
-    while (torpNr > 1 && TorpTechLevel(torpNr) > torpTech) {
-        --torpNr;
+    const Uns16 mineId = p->MineId;
+    const Uns16 planetId = p->PlanetId;
+
+    const Uns16 oldRadius = Snapshot_MinefieldRadius(s, mineId);
+    const Uns32 existingUnits = s->Minefields.Units[mineId];
+    const Boolean isWeb = s->Minefields.IsWeb[mineId];
+
+    // Determine scooping rate. Scooping rate is same as laying rate.
+    const Uns32 torpNr = s->Profiles.Bases[planetId].ScoopTorpNr;
+    const Uns32 torpRate = Profiles_UnitsPerTorp(&s->Profiles, s->Planets.Owner[planetId], torpNr, isWeb);
+
+    // Determine number of torpedoes we get by sweeping the entire field.
+    // A fractional torpedo is discarded.
+    const Uns16 existingTorps = s->Bases.Torps[planetId][torpNr-1];
+    Uns32 newTorps = existingTorps + (existingUnits / torpRate);
+
+    // Check whether torpedoes fit into the base.
+    Uns32 remainingUnits;
+    if (newTorps <= MAX_BASE_TORPS) {
+        // Yes, torpedoes fit. Minefield is gone.
+        remainingUnits = 0;
+    } else if (existingTorps <= MAX_BASE_TORPS) {
+        // Base has some room, but not for everything.
+        // Scoop what we can (plus the fractional torpedo which does not end up in storage).
+        remainingUnits = (newTorps - MAX_BASE_TORPS) * torpRate;
+        newTorps = MAX_BASE_TORPS;
+    } else {
+        // Base was already overloaded before, don't change anything.
+        remainingUnits = existingUnits;
+        newTorps = existingTorps;
     }
-    return torpNr;
+    Snapshot_PutMinefieldUnits(s, mineId, remainingUnits);
+    Snapshot_PutBaseTorps(s, planetId, torpNr, newTorps);
+
+    Info("\t(+) Base %d, minefield %d: scooping miness", planetId, mineId);
+    Message_MinefieldScooped(s->Planets.Owner[planetId], planetId, mineId, s->Minefields.X[mineId], s->Minefields.Y[mineId], oldRadius, newTorps - existingTorps, isWeb);
 }
 
-static void ScoopFromPlanet(const struct Config* c, Uns16 planetId)
+/* Apply all demands against one minefield, in the order they were gathered.
+   Each player involved receives a single minefield report with the final size. */
+static void ApplyDemands(struct Snapshot* s, const struct SweepDemand* p, size_t n)
 {
-    Uns16* candidates = EnumerateMinesWithinRadius(PlanetLocationX(planetId), PlanetLocationY(planetId), c->BeamSweepRange);
-    for (size_t i = 0; candidates[i] != 0; ++i) {
-        Uns16 mineId = candidates[i];
-        if (PlanetScoopsMine(planetId, mineId)) {
-            const Uns16 oldRadius = MinefieldRadius(mineId);
-            const Uns32 existingUnits = MinefieldUnits(mineId);
-
-            // Determine scooping rate. Scooping rate is same as laying rate.
-            const Uns32 torpNr = TorpNrForScooping(planetId);
-            const Uns32 torpRate = UnitsPerTorpedoRate(c, PlanetOwner(planetId), torpNr, IsMinefieldWeb(mineId));
-
-            // Determine number of torpedoes we get by sweeping the entire field.
-            // A fractional torpedo is discarded.
-            const Uns16 existingTorps = BaseTorps(planetId, torpNr);
-            Uns32 newTorps = existingTorps + (existingUnits / torpRate);
-
-            // Check whether torpedoes fit into the base.
-            Uns32 remainingUnits;
-            if (newTorps <= MAX_BASE_TORPS) {
-                // Yes, torpedoes fit. Minefield is gone.
-                remainingUnits = 0;
-            } else if (existingTorps <= MAX_BASE_TORPS) {
-                // Base has some room, but not for everything.
-                // Scoop what we can (plus the fractional torpedo which does not end up in storage).
-                remainingUnits = (newTorps - MAX_BASE_TORPS) * torpRate;
-                newTorps = MAX_BASE_TORPS;
-            } else {
-                // Base was already overloaded before, don't change anything.
-                remainingUnits = existingUnits;
-                newTorps = existingTorps;
-            }
-            PutMinefieldUnits(mineId, remainingUnits);
-            PutBaseTorps(planetId, torpNr, newTorps);
+    const Uns16 mineId = p[0].MineId;
+    Uns32 players = 0;
+    for (size_t i = 0; i < n; ++i) {
+        // A field that has been emptied by a previous demand is not a candidate anymore.
+        if (s->Minefields.Units[mineId] == 0) {
+            break;
+        }
+        if (p[i].Kind == SK_Scoop) {
+            ApplyScoop(s, &p[i]);
+        } else {
+            ApplySweep(s, &p[i]);
+        }
+        players |= OwnerMask(s->Planets.Owner[p[i].PlanetId]);
+    }
 
-            Info("\t(+) Base %d, minefield %d: scooping miness", planetId, mineId);
-            Message_MinefieldScooped(PlanetOwner(planetId), planetId, mineId, MinefieldPositionX(mineId), MinefieldPositionY(mineId), oldRadius, newTorps - existingTorps, IsMinefieldWeb(mineId));
-            Util_Minefield(PlanetOwner(planetId), mineId, MinefieldPositionX(mineId), MinefieldPositionY(mineId), MinefieldOwner(mineId), remainingUnits, IsMinefieldWeb(mineId), MINE_SWEPT);
+    for (RaceType_Def player = 1; player <= RACE_NR; ++player) {
+        if (players & OwnerMask(player)) {
+            const struct SnapshotMinefields* m = &s->Minefields;
+            Util_Minefield(player, mineId, m->X[mineId], m->Y[mineId], m->Owner[mineId], m->Units[mineId], m->IsWeb[mineId], MINE_SWEPT);
         }
     }
 }
 
-void DoMineSweeping(const struct Config* c)
+void DoMineSweeping(struct Snapshot* s, const struct Config* c)
 {
     if (c->BeamSweepMines || c->FighterSweepMines || c->ScoopMinefields) {
         Info("    Sweeping/scooping minefields...");
-        for (Uns16 i = 1; i <= PLANET_NR; ++i) {
-            if (IsBaseExist(i)) {
-                if (PlanetHasFCode(i, "SMF")) {
+
+        // Phase 1: gather demands of all bases, in order of base Id
+        struct SweepDemands d = { NULL, 0, 0 };
+        const struct ScheduleList list = Schedule_Get(&s->Schedule, SS_MineSweeping);
+        for (Uns16 n = 0; n < list.Count; ++n) {
+            const Uns16 i = list.Ids[n];
+            if (s->Bases.Exists[i]) {
+                const enum FCodeAction action = s->Planets.Action[i];
+                if (action == FC_SweepMines) {
                     if (c->BeamSweepMines) {
-                        SweepUsingBeams(c, i);
+                        SweepUsingBeams(s, &d, i);
                     }
                     if (c->FighterSweepMines) {
-                        SweepUsingFighters(c, i);
+                        SweepUsingFighters(s, &d, i);
                     }
                 }
-                if (c->ScoopMinefields && PlanetHasFCode(i, "MSC")) {
-                    ScoopFromPlanet(c, i);
+                if (c->ScoopMinefields && action == FC_ScoopMines) {
+                    ScoopFromPlanet(s, c, &d, i);
                 }
             }
         }
+
+        // Phase 2: apply per minefield.
+        // Minefields are independent of each other, and a base's torpedo storage is only
+        // affected by its own scooping, so this yields the same result as processing
+        // bases one after the other. Only the order of messages changes: they now
+        // come in minefield Id order, not base Id order.
+        qsort(d.Items, d.Count, sizeof(*d.Items), CompareDemands);
+        for (size_t i = 0; i < d.Count; ) {
+            size_t n = 1;
+            while (i+n < d.Count && d.Items[i+n].MineId == d.Items[i].MineId) {
+                ++n;
+            }
+            ApplyDemands(s, &d.Items[i], n);
+            i += n;
+        }
+        free(d.Items);
+
         if (c->BeamSweepMines || c->FighterSweepMines) {
-            DefineSpecialFCode("SMF");
+            FCode_DefineSpecial(FC_SweepMines);
         }
         if (c->ScoopMinefields) {
-            DefineSpecialFCode("MSC");
+            FCode_DefineSpecial(FC_ScoopMines);
         }
     } else {
         Info("    Sweeping/scooping minefields disabled.");
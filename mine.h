@@ -6,13 +6,16 @@
 #define MINE_H_INCLUDED
 
 struct Config;
+struct Snapshot;
 
 /** Mine Sweeping/Scooping Stage.
-    @param [in] c Configuration */
-void DoMineSweeping(const struct Config* c);
+    @param [in,out] s Game snapshot
+    @param [in]     c Configuration */
+void DoMineSweeping(struct Snapshot* s, const struct Config* c);
 
 /** Mine Laying Stage.
-    @param [in] c Configuration */
-void DoMineLaying(const struct Config* c);
+    @param [in,out] s Game snapshot
+    @param [in]     c Configuration */
+void DoMineLaying(struct Snapshot* s, const struct Config* c);
 
 #endif
@@ -0,0 +1,174 @@
+/**
+  *  \file mineindex.c
+  *  \brief Starbase Reloaded - Minefield Location Index
+  */
+
+#include <string.h>
+#include "mineindex.h"
+#include "util.h"
+
+/* Grid cell size in light years.
+   Typical query ranges (sweep range, fighter range, minefield radius) are 50..150 ly. */
+static const Uns32 CELL_SIZE = 64;
+
+/* Highest coordinate. */
+static const Uns32 MAX_COORDINATE = 0xFFFF;
+
+/* A range of grid cells along one axis (inclusive). */
+struct CellRange {
+    Uns32 From, To;
+};
+
+static int PartitionForOwner(RaceType_Def owner)
+{
+    return (owner > 0 && owner <= RACE_NR) ? owner : 0;
+}
+
+static Uns32 Bucket(Uns32 cx, Uns32 cy)
+{
+    return ((cx * 0x9E3779B1u) ^ (cy * 0x85EBCA77u)) >> (32 - MINEINDEX_BUCKET_BITS);
+}
+
+static Uns32 BucketForPosition(Uns16 x, Uns16 y)
+{
+    return Bucket(x / CELL_SIZE, y / CELL_SIZE);
+}
+
+static struct CellRange MakeCellRange(Uns32 from, Uns32 to)
+{
+    struct CellRange r = { from / CELL_SIZE, to / CELL_SIZE };
+    return r;
+}
+
+/* Determine cells to visit along one axis. Returns number of ranges (1 or 2). */
+static int GetCellRanges(Uns16 pos, Uns16 range, int axis, struct CellRange* out)
+{
+    if (gPconfigInfo->AllowWraparoundMap) {
+        const Uns32 min = gPconfigInfo->WraparoundRectangle[axis];
+        const Uns32 max = gPconfigInfo->WraparoundRectangle[axis+2];
+        const Uns32 size = max - min;
+        if (max > min && pos >= min && pos < max) {
+            if (2 * (Uns32) range >= size) {
+                out[0] = MakeCellRange(min, max-1);
+                return 1;
+            } else if (pos < min + range) {
+                out[0] = MakeCellRange(min, pos + range);
+                out[1] = MakeCellRange(pos + size - range, max-1);
+                return 2;
+            } else if (pos + range >= max) {
+                out[0] = MakeCellRange(pos - range, max-1);
+                out[1] = MakeCellRange(min, pos + range - size);
+                return 2;
+            } else {
+                // Does not touch the seam
+            }
+        }
+    }
+
+    out[0] = MakeCellRange(pos > range ? pos - range : 0, MIN(MAX_COORDINATE, (Uns32) pos + range));
+    return 1;
+}
+
+static Uns16 CollectBucket(const struct MineIndex* idx, Uns32 bucket, Uns32 ownerMask, Uns16* result, Uns16 n)
+{
+    for (int owner = 0; owner <= RACE_NR; ++owner) {
+        if (ownerMask & (1UL << owner)) {
+            for (Uns16 mineId = idx->Head[owner][bucket]; mineId != 0; mineId = idx->Next[mineId]) {
+                result[n++] = mineId;
+            }
+        }
+    }
+    return n;
+}
+
+
+/*
+ *  Public Interface
+ */
+
+void MineIndex_Init(struct MineIndex* idx)
+{
+    memset(idx, 0, sizeof(*idx));
+}
+
+void MineIndex_Add(struct MineIndex* idx, Uns16 mineId, RaceType_Def owner, Uns16 x, Uns16 y, Uns16 radius)
+{
+    if (mineId > 0 && mineId <= MINE_NR) {
+        const int part = PartitionForOwner(owner);
+        const Uns32 bucket = BucketForPosition(x, y);
+        idx->Next[mineId] = idx->Head[part][bucket];
+        idx->Head[part][bucket] = mineId;
+        MineIndex_UpdateRadius(idx, owner, radius);
+    }
+}
+
+void MineIndex_Remove(struct MineIndex* idx, Uns16 mineId, RaceType_Def owner, Uns16 x, Uns16 y)
+{
+    Uns16* p = &idx->Head[PartitionForOwner(owner)][BucketForPosition(x, y)];
+    while (*p != 0) {
+        if (*p == mineId) {
+            *p = idx->Next[mineId];
+            idx->Next[mineId] = 0;
+            break;
+        }
+        p = &idx->Next[*p];
+    }
+}
+
+void MineIndex_UpdateRadius(struct MineIndex* idx, RaceType_Def owner, Uns16 radius)
+{
+    const int part = PartitionForOwner(owner);
+    idx->MaxRadius[part] = MAX(idx->MaxRadius[part], radius);
+}
+
+Uns16 MineIndex_MaxRadius(const struct MineIndex* idx, Uns32 ownerMask)
+{
+    Uns16 result = 0;
+    for (int owner = 0; owner <= RACE_NR; ++owner) {
+        if (ownerMask & (1UL << owner)) {
+            result = MAX(result, idx->MaxRadius[owner]);
+        }
+    }
+    return result;
+}
+
+Uns16 MineIndex_FindCandidates(const struct MineIndex* idx, Uns16 x, Uns16 y, Uns16 range, Uns32 ownerMask, Uns16* result)
+{
+    struct CellRange xr[2], yr[2];
+    const int nx = GetCellRanges(x, range, 0, xr);
+    const int ny = GetCellRanges(y, range, 1, yr);
+
+    // If the query covers more cells than there are buckets, just look at all buckets.
+    Uns32 numCells = 0;
+    for (int i = 0; i < nx; ++i) {
+        for (int j = 0; j < ny; ++j) {
+            numCells += (xr[i].To - xr[i].From + 1) * (yr[j].To - yr[j].From + 1);
+        }
+    }
+
+    Uns16 n = 0;
+    if (numCells >= MINEINDEX_BUCKETS) {
+        for (Uns32 bucket = 0; bucket < MINEINDEX_BUCKETS; ++bucket) {
+            n = CollectBucket(idx, bucket, ownerMask, result, n);
+        }
+    } else {
+        // Different cells can map to the same bucket; visit each bucket only once
+        // so that no minefield is reported twice.
+        Uns32 visited[MINEINDEX_BUCKETS / 32];
+        memset(visited, 0, sizeof(visited));
+        for (int i = 0; i < nx; ++i) {
+            for (int j = 0; j < ny; ++j) {
+                for (Uns32 cx = xr[i].From; cx <= xr[i].To; ++cx) {
+                    for (Uns32 cy = yr[j].From; cy <= yr[j].To; ++cy) {
+                        const Uns32 bucket = Bucket(cx, cy);
+                        if ((visited[bucket / 32] & (1UL << (bucket % 32))) == 0) {
+                            visited[bucket / 32] |= 1UL << (bucket % 32);
+                            n = CollectBucket(idx, bucket, ownerMask, result, n);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return n;
+}
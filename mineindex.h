@@ -0,0 +1,71 @@
+/**
+  *  \file mineindex.h
+  *  \brief Starbase Reloaded - Minefield Location Index
+  *
+  *  Minefield centers are stored in a uniform grid, separately for each owner.
+  *  Grid cells are hashed into a fixed number of buckets, so the index size
+  *  does not depend on the map size.
+  *
+  *  The index only pre-selects candidates; callers must check actual distances.
+  */
+#ifndef MINEINDEX_H_INCLUDED
+#define MINEINDEX_H_INCLUDED
+
+#include <phostpdk.h>
+
+#define MINEINDEX_BUCKET_BITS 10
+#define MINEINDEX_BUCKETS     (1 << MINEINDEX_BUCKET_BITS)
+
+/** Owner mask selecting all owners. */
+#define MINEINDEX_ALL_OWNERS  ((Uns32) ((1UL << (RACE_NR+1)) - 1))
+
+/** Minefield index. */
+struct MineIndex {
+    Uns16 Head[RACE_NR+1][MINEINDEX_BUCKETS];   /**< First minefield in each bucket, per owner. */
+    Uns16 Next[MINE_NR+1];                      /**< Next minefield in same bucket. */
+    Uns16 MaxRadius[RACE_NR+1];                 /**< Upper bound for radius of each owner's minefields. */
+};
+
+/** Initialize empty index.
+    @param [out] idx Index */
+void MineIndex_Init(struct MineIndex* idx);
+
+/** Add minefield.
+    @param [in,out] idx    Index
+    @param [in]     mineId Minefield Id
+    @param [in]     owner  Owner
+    @param [in]     x,y    Position
+    @param [in]     radius Radius */
+void MineIndex_Add(struct MineIndex* idx, Uns16 mineId, RaceType_Def owner, Uns16 x, Uns16 y, Uns16 radius);
+
+/** Remove minefield.
+    @param [in,out] idx    Index
+    @param [in]     mineId Minefield Id
+    @param [in]     owner  Owner (same as given to MineIndex_Add)
+    @param [in]     x,y    Position (same as given to MineIndex_Add) */
+void MineIndex_Remove(struct MineIndex* idx, Uns16 mineId, RaceType_Def owner, Uns16 x, Uns16 y);
+
+/** Update radius of a minefield.
+    @param [in,out] idx    Index
+    @param [in]     owner  Owner
+    @param [in]     radius New radius */
+void MineIndex_UpdateRadius(struct MineIndex* idx, RaceType_Def owner, Uns16 radius);
+
+/** Get upper bound for minefield radius.
+    @param [in] idx       Index
+    @param [in] ownerMask Owners to check (bit N set for owner N)
+    @return Maximum radius */
+Uns16 MineIndex_MaxRadius(const struct MineIndex* idx, Uns32 ownerMask);
+
+/** Find candidate minefields near a point.
+    Returns (at least) all minefields whose center is within the given distance.
+    Honors wrap-around if configured.
+    @param [in]  idx       Index
+    @param [in]  x,y       Position
+    @param [in]  range     Distance
+    @param [in]  ownerMask Owners to return (bit N set for owner N)
+    @param [out] result    Minefield Ids, unsorted, each at most once; must have room for MINE_NR elements
+    @return Number of elements stored in result */
+Uns16 MineIndex_FindCandidates(const struct MineIndex* idx, Uns16 x, Uns16 y, Uns16 range, Uns32 ownerMask, Uns16* result);
+
+#endif
@@ -0,0 +1,123 @@
+/**
+  *  \file prescan.c
+  *  \brief Starbase Reloaded - Idle Turn Detection
+  */
+
+#include <string.h>
+#include "prescan.h"
+#include "config.h"
+#include "transport.h"
+#include "fcode.h"
+
+#define DIM(x) (sizeof(x)/sizeof(x[0]))
+
+/*
+ *  File format definitions
+ */
+
+static const char*const PLANET_FILE_NAME = "pdata.hst";
+static const size_t PLANET_RECORD_SIZE = 85;
+static const size_t PLANET_OWNER_OFFSET = 0;
+static const size_t PLANET_FCODE_OFFSET = 4;
+
+/* Ships 1..500 are in ship.hst; a Host999 game stores the rest in ship2.hst. */
+static const char*const SHIP_FILE_NAMES[] = { "ship.hst", "ship2.hst" };
+static const size_t SHIP_RECORD_SIZE = 107;
+static const size_t SHIP_OWNER_OFFSET = 2;
+static const size_t SHIP_FCODE_OFFSET = 4;
+static const size_t SHIP_NAME_OFFSET = 45;
+
+
+/*
+ *  Friendly code matching
+ */
+
+/* Check whether a friendly code triggers an action in the current phase. */
+static Boolean IsActive(const char* fc, enum FCodeTarget target, Boolean beforeMovement)
+{
+    const enum FCodeAction action = FCode_Decode(fc, target, NULL);
+    return action != FC_None && FCode_IsBeforeMovement(action) == beforeMovement;
+}
+
+/*
+ *  File scanning
+ */
+
+/* Scan planets. Returns true if any planet has a matching code, or the file cannot be read. */
+static Boolean ScanPlanets(Boolean beforeMovement)
+{
+    FILE* f = OpenInputFile(PLANET_FILE_NAME, GAME_DIR_ONLY | NO_MISSING_ERROR);
+    if (f == NULL) {
+        return True;
+    }
+
+    Boolean found = False;
+    Uns8 rec[PLANET_RECORD_SIZE];
+    Uns16 n = 0;
+    while (!found && n < PLANET_NR && fread(rec, 1, sizeof(rec), f) == sizeof(rec)) {
+        if (rec[PLANET_OWNER_OFFSET] != 0 || rec[PLANET_OWNER_OFFSET+1] != 0) {
+            found = IsActive((const char*) &rec[PLANET_FCODE_OFFSET], FCT_Planet, beforeMovement);
+        }
+        ++n;
+    }
+    fclose(f);
+
+    return found || n < PLANET_NR;
+}
+
+/* Scan ships. Returns true if any ship has a matching code or tagged name, or the file cannot be read. */
+static Boolean ScanShips(Boolean beforeMovement, Boolean checkNames)
+{
+    const size_t prefixLength = strlen(TRANSPORT_NAME_PREFIX);
+    Boolean found = False;
+    Uns16 n = 0;
+    for (size_t i = 0; !found && i < DIM(SHIP_FILE_NAMES) && n < SHIP_NR; ++i) {
+        FILE* f = OpenInputFile(SHIP_FILE_NAMES[i], GAME_DIR_ONLY | NO_MISSING_ERROR);
+        if (f == NULL) {
+            // Missing ship.hst means we cannot tell; missing ship2.hst means a Host500 game.
+            return (i == 0);
+        }
+
+        Uns8 rec[SHIP_RECORD_SIZE];
+        while (!found && n < SHIP_NR && fread(rec, 1, sizeof(rec), f) == sizeof(rec)) {
+            if (rec[SHIP_OWNER_OFFSET] != 0 || rec[SHIP_OWNER_OFFSET+1] != 0) {
+                found = IsActive((const char*) &rec[SHIP_FCODE_OFFSET], FCT_Ship, beforeMovement)
+                    || (checkNames && memcmp(&rec[SHIP_NAME_OFFSET], TRANSPORT_NAME_PREFIX, prefixLength) == 0);
+            }
+            ++n;
+        }
+        fclose(f);
+    }
+    return found;
+}
+
+static Boolean HaveTransports(void)
+{
+    struct TransportState st;
+    TransportState_Load(&st, TP_None);
+    const Boolean result = !TransportState_IsEmpty(&st);
+    TransportState_Free(&st);
+    return result;
+}
+
+
+/*
+ *  Public Interface
+ */
+
+Boolean Prescan_IsIdle(Boolean beforeMovement, const struct Config* c)
+{
+    if (beforeMovement) {
+        // Only planet codes are processed before movement.
+        if (ScanPlanets(True)) {
+            return False;
+        }
+    } else {
+        if (ScanPlanets(False) || ScanShips(False, c->TagSpecialTransport)) {
+            return False;
+        }
+    }
+
+    // Existing transports need trimming and reports every turn.
+    return !HaveTransports();
+}
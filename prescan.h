@@ -0,0 +1,22 @@
+/**
+  *  \file prescan.h
+  *  \brief Starbase Reloaded - Idle Turn Detection
+  */
+#ifndef PRESCAN_H_INCLUDED
+#define PRESCAN_H_INCLUDED
+
+#include <phostpdk.h>
+
+struct Config;
+
+/** Check whether this turn needs any work.
+    Scans friendly codes directly from the host files, without loading the host data,
+    and checks the state file for special transports.
+    This errs on the safe side: if anything cannot be determined, the turn is considered busy.
+    @param [in] beforeMovement True for auxhost1, false for auxhost2
+    @param [in] c              Configuration
+    @return True if there is nothing to do
+    @pre PDK initialized (gGameDirectory set) */
+Boolean Prescan_IsIdle(Boolean beforeMovement, const struct Config* c);
+
+#endif
@@ -0,0 +1,197 @@
+/**
+  *  \file profile.c
+  *  \brief Starbase Reloaded - Derived Base and Player Data
+  */
+
+#include <string.h>
+#include "profile.h"
+#include "config.h"
+#include "snapshot.h"
+#include "util.h"
+
+/* With this option set, we try to reproduce psbplus behaviour more closely:
+   torpedo-to-mine uses tech-squared, not slot-squared.
+   Slot-squared is more consistent with the rest of the game, and seems to be
+   what the original documentation (STARBASE.TXT) implies. */
+static const Boolean USE_TORP_TECH = False;
+
+/*
+ *  Players
+ */
+
+static Uns32 ComputeUnitsPerTorp(RaceType_Def owner, Uns16 torpNr, Boolean isWeb)
+{
+    if (USE_TORP_TECH) {
+        torpNr = TorpTechLevel(torpNr);
+    }
+
+    Uns32 rate = torpNr * torpNr;
+
+    if (owner > 0 && owner <= RACE_NR) {
+        Uns16 playerRate = (isWeb
+                            ? gPconfigInfo->UnitsPerWebRate[owner]
+                            : gPconfigInfo->UnitsPerTorpRate[owner]);
+
+        rate = rate * playerRate / 100;
+    }
+
+    return MAX(rate, 1);
+}
+
+static Uns32 ComputeMaxMineUnits(RaceType_Def owner, Boolean isWeb)
+{
+    Uns32 maxRadius = isWeb
+        ? gPconfigInfo->MaximumWebMinefieldRadius[owner]
+        : gPconfigInfo->MaximumMinefieldRadius[owner];
+
+    return maxRadius*maxRadius;
+}
+
+static void BuildPlayers(struct Profiles* p)
+{
+    for (RaceType_Def owner = 0; owner <= RACE_NR; ++owner) {
+        for (int isWeb = 0; isWeb < 2; ++isWeb) {
+            for (Uns16 torpNr = 1; torpNr <= TORP_NR; ++torpNr) {
+                p->UnitsPerTorp[owner][torpNr-1][isWeb] = ComputeUnitsPerTorp(owner, torpNr, isWeb);
+            }
+            p->MaxMineUnits[owner][isWeb] = ComputeMaxMineUnits(owner, isWeb);
+        }
+    }
+}
+
+
+/*
+ *  Bases
+ */
+
+static Uns32 BeamSweepCapacity(const struct Snapshot* s, const struct Config* c, Uns16 planetId, Boolean isWeb)
+{
+    // CHANGE: pstarbase divide by 20 last, but STARBASE.TXT says we do it here
+    Uns16 numBeams = s->Bases.Defense[planetId] / 20;
+    Uns16 beamTech = s->Bases.BeamTech[planetId];
+    Uns16 rate = isWeb ? c->BeamWebSweepRate : c->BeamSweepRate;
+
+    return (Uns32) rate * beamTech *  beamTech * numBeams;
+}
+
+static void SetFighterCapacity(struct BaseProfile* b, const struct Snapshot* s, const struct Config* c, Uns16 planetId)
+{
+    Uns32 mineCapacity, webCapacity;
+    Uns16 range;
+    if (gPconfigInfo->PlayerRace[s->Planets.Owner[planetId]] == Colonies) {
+        // Colonies: can always sweep mines with fighters; can sweep webs if configured in PCONFIG; always 100 ly range.
+        mineCapacity = c->FtrSweepRate;
+        webCapacity  = gPconfigInfo->ColSweepWebs ? c->FtrWebSweepRate : 0;
+        range = 100;
+    } else {
+        // Others: can sweep mines only if configured; can never sweep webs; dynamic range.
+        mineCapacity = c->ColonialFighterOnlySweepMines ? 0 : c->FtrSweepRate;
+        webCapacity = 0;
+        range = 10 * ((s->Bases.HullTech[planetId] + s->Bases.EngineTech[planetId] + s->Bases.BeamTech[planetId]) / 3);
+    }
+
+    b->FighterMineCapacity = mineCapacity * s->Bases.Fighters[planetId];
+    b->FighterWebCapacity  = webCapacity * s->Bases.Fighters[planetId];
+    b->FighterRange        = range;
+}
+
+static Uns16 TorpNrForScooping(const struct Snapshot* s, Uns16 planetId)
+{
+    // We always scoop into the best torpedo slot the base can build.
+    Uns16 torpTech = s->Bases.TorpTech[planetId];
+    Uns16 torpNr = TORP_NR;
+    while (torpNr > 1 && TorpTechLevel(torpNr) > torpTech) {
+        --torpNr;
+    }
+    return torpNr;
+}
+
+static void ReserveComponents(struct BaseProfile* b, BaseTech_Def type, Uns16 slot, Uns16 count)
+{
+    const int index = TransportShip_SlotIndex(type, slot);
+    if (index < TRANSPORT_SLOT_NR) {
+        b->ReservedComponents[index] = count;
+    }
+}
+
+static void SetReservedComponents(struct BaseProfile* b, const struct Snapshot* s, Uns16 planetId)
+{
+    if (b->HasBuildOrder) {
+        const BuildOrder_Struct* order = &b->BuildOrder;
+        // FIXME: MapTruehullByPlayerRace?
+        ReserveComponents(b, ENGINE_TECH, order->mEngineType, HullEngineNumber(EffTrueHull(s->Bases.Owner[planetId], order->mHull)));
+        ReserveComponents(b, BEAM_TECH,   order->mBeamType,   order->mNumBeams);
+        ReserveComponents(b, TORP_TECH,   order->mTubeType,   order->mNumTubes);
+    }
+}
+
+static void BuildBases(struct Profiles* p, const struct Snapshot* s, const struct Config* c)
+{
+    for (Uns16 i = 1; i <= PLANET_NR; ++i) {
+        struct BaseProfile* b = &p->Bases[i];
+        if (s->Bases.Exists[i]) {
+            b->BeamMineCapacity = BeamSweepCapacity(s, c, i, False);
+            b->BeamWebCapacity  = BeamSweepCapacity(s, c, i, True);
+            // FIXME: PLAYER.md says BeamSweepRange, but we have always been using BeamSweepRate here
+            b->BeamRange        = c->BeamSweepRate;
+            SetFighterCapacity(b, s, c, i);
+            b->ScoopTorpNr      = TorpNrForScooping(s, i);
+            b->TotalTech        = s->Bases.HullTech[i] + s->Bases.EngineTech[i] + s->Bases.BeamTech[i] + s->Bases.TorpTech[i];
+            b->HasBuildOrder    = BaseBuildOrder(i, &b->BuildOrder);
+            SetReservedComponents(b, s, i);
+        }
+    }
+}
+
+
+/*
+ *  Transported Components
+ */
+
+static void BuildComponents(struct Profiles* p, const struct Config* c)
+{
+    // Components weigh at least CargoSpacePerComp, but can weigh more if configured in the ship list.
+    // Engines and invalid slots (last element) weigh CargoSpacePerComp.
+    // Masses must not be 0.
+    const Uns16 minMass = MAX(c->CargoSpacePerComp, 1);
+    for (int i = 0; i <= TRANSPORT_SLOT_NR; ++i) {
+        p->ComponentMass[i] = minMass;
+    }
+    for (Uns16 i = 1; i <= BEAM_NR; ++i) {
+        p->ComponentMass[TransportShip_SlotIndex(BEAM_TECH, i)] = MAX(minMass, BeamMass(i));
+    }
+    for (Uns16 i = 1; i <= TORP_NR; ++i) {
+        p->ComponentMass[TransportShip_SlotIndex(TORP_TECH, i)] = MAX(minMass, TorpTubeMass(i));
+    }
+}
+
+/*
+ *  Public Interface
+ */
+
+void Profiles_Build(struct Profiles* p, const struct Snapshot* s, const struct Config* c)
+{
+    memset(p, 0, sizeof(*p));
+    BuildPlayers(p);
+    BuildBases(p, s, c);
+    BuildComponents(p, c);
+}
+
+Uns32 Profiles_UnitsPerTorp(const struct Profiles* p, RaceType_Def owner, Uns16 torpNr, Boolean isWeb)
+{
+    if (torpNr == 0 || torpNr > TORP_NR) {
+        return 1;
+    }
+    if (owner > RACE_NR) {
+        owner = 0;
+    }
+    return p->UnitsPerTorp[owner][torpNr-1][isWeb != 0];
+}
+
+Uns32 Profiles_MaxMineUnits(const struct Profiles* p, RaceType_Def owner, Boolean isWeb)
+{
+    if (owner > RACE_NR) {
+        owner = 0;
+    }
+    return p->MaxMineUnits[owner][isWeb != 0];
+}
@@ -0,0 +1,62 @@
+/**
+  *  \file profile.h
+  *  \brief Starbase Reloaded - Derived Base and Player Data
+  *
+  *  Values that are derived from the game and configuration and do not
+  *  change while we run are computed once, after the snapshot has been loaded.
+  */
+#ifndef PROFILE_H_INCLUDED
+#define PROFILE_H_INCLUDED
+
+#include <phostpdk.h>
+#include "transport.h"
+
+struct Config;
+struct Snapshot;
+
+/** Capabilities of a starbase. */
+struct BaseProfile {
+    Uns32 BeamMineCapacity;           /**< Mine units swept using beams, per minefield. */
+    Uns32 BeamWebCapacity;            /**< Web mine units swept using beams, per minefield. */
+    Uns16 BeamRange;                  /**< Range for sweeping with beams. */
+    Uns32 FighterMineCapacity;        /**< Mine units swept using fighters, per minefield. */
+    Uns32 FighterWebCapacity;         /**< Web mine units swept using fighters, per minefield. */
+    Uns16 FighterRange;               /**< Range for sweeping with fighters. */
+    Uns16 ScoopTorpNr;                /**< Torpedo type produced by scooping (1-based). */
+    Uns16 TotalTech;                  /**< Sum of all tech levels. */
+    Boolean HasBuildOrder;            /**< True if base has a build order. */
+    BuildOrder_Struct BuildOrder;     /**< Build order, if HasBuildOrder is set. */
+    Uns16 ReservedComponents[TRANSPORT_SLOT_NR+1];   /**< Components needed for the build order, indexed by TransportShip_SlotIndex(). Last element is 0. */
+};
+
+/** Derived data. */
+struct Profiles {
+    struct BaseProfile Bases[PLANET_NR+1];            /**< Starbases, indexed by planet Id. Zero if no base. */
+    Uns32 UnitsPerTorp[RACE_NR+1][TORP_NR][2];        /**< Mine units per torpedo, indexed by owner, type-1, isWeb. */
+    Uns32 MaxMineUnits[RACE_NR+1][2];                 /**< Maximum minefield size, indexed by owner, isWeb. */
+    Uns16 ComponentMass[TRANSPORT_SLOT_NR+1];         /**< Cargo room per transported component, indexed by TransportShip_SlotIndex(). Never 0. */
+};
+
+/** Compute derived data.
+    @param [out] p Profiles
+    @param [in]  s Snapshot
+    @param [in]  c Configuration */
+void Profiles_Build(struct Profiles* p, const struct Snapshot* s, const struct Config* c);
+
+/** Get mine units per torpedo.
+    This is the rate for both laying and scooping.
+    @param [in] p      Profiles
+    @param [in] owner  Player
+    @param [in] torpNr Torpedo type (1-based)
+    @param [in] isWeb  True for web mines
+    @return Units per torpedo; never 0 */
+Uns32 Profiles_UnitsPerTorp(const struct Profiles* p, RaceType_Def owner, Uns16 torpNr, Boolean isWeb);
+
+/** Get maximum minefield size.
+    @param [in] p      Profiles
+    @param [in] owner  Player
+    @param [in] isWeb  True for web mines
+    @return Maximum number of units */
+Uns32 Profiles_MaxMineUnits(const struct Profiles* p, RaceType_Def owner, Boolean isWeb);
+
+#endif
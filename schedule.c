@@ -0,0 +1,117 @@
+/**
+  *  \file schedule.c
+  *  \brief Starbase Reloaded - Work Lists
+  */
+
+#include <string.h>
+#include "schedule.h"
+#include "snapshot.h"
+#include "transport.h"
+
+/* Interestingly, PDK doesn't have this. */
+#ifndef SHIPNAME_SIZE
+# define SHIPNAME_SIZE 20
+#endif
+
+/* Mapping of planet friendly code actions to stages. */
+static enum ScheduleStage PlanetStage(enum FCodeAction action)
+{
+    switch (action) {
+     case FC_SweepMines:
+     case FC_ScoopMines:
+        return SS_MineSweeping;
+     case FC_LayMines:
+     case FC_LayWebMines:
+        return SS_MineLaying;
+     case FC_ReceiveMoney:
+        return SS_ReceiveMoney;
+     case FC_TransferMoney:
+        return SS_TransferMoney;
+     case FC_SendConfig:
+        return SS_SendConfig;
+     default:
+        return SS_None;
+    }
+}
+
+/* Mapping of ship friendly code actions to stages. */
+static enum ScheduleStage ShipStage(enum FCodeAction action)
+{
+    switch (action) {
+     case FC_UnloadAll:
+     case FC_UnloadEngine:
+     case FC_UnloadBeam:
+     case FC_UnloadLauncher:
+        return SS_Unload;
+     case FC_GetEngine:
+     case FC_GetBeam:
+     case FC_GetLauncher:
+        return SS_Load;
+     default:
+        return SS_None;
+    }
+}
+
+static Boolean IsTagged(Uns16 shipId)
+{
+    char buf[SHIPNAME_SIZE+1];
+    ShipName(shipId, buf);
+    return memcmp(buf, TRANSPORT_NAME_PREFIX, strlen(TRANSPORT_NAME_PREFIX)) == 0;
+}
+
+void Schedule_Build(struct Schedule* sch, const struct Snapshot* s)
+{
+    /* Classify all objects once. A ship can be on an action list and on the tagged list. */
+    static Uns8 planetStage[PLANET_NR+1];
+    static Uns8 shipStage[SHIP_NR+1];
+    static Boolean shipTagged[SHIP_NR+1];
+    Uns16 count[SCHEDULE_STAGE_NR];
+    memset(count, 0, sizeof(count));
+
+    for (Uns16 i = 1; i <= PLANET_NR; ++i) {
+        planetStage[i] = (s->Planets.Exists[i] ? PlanetStage(s->Planets.Action[i]) : SS_None);
+        ++count[planetStage[i]];
+    }
+    for (Uns16 i = 1; i <= SHIP_NR; ++i) {
+        shipStage[i] = (s->Ships.Exists[i] ? ShipStage(s->Ships.Action[i]) : SS_None);
+        shipTagged[i] = (s->Ships.Exists[i] && IsTagged(i));
+        ++count[shipStage[i]];
+        if (shipTagged[i]) {
+            ++count[SS_Tagged];
+        }
+    }
+
+    /* Lay out lists. SS_None is not stored. */
+    count[SS_None] = 0;
+    Uns16 fill[SCHEDULE_STAGE_NR];
+    sch->Start[0] = 0;
+    for (int i = 0; i < SCHEDULE_STAGE_NR; ++i) {
+        fill[i] = sch->Start[i];
+        sch->Start[i+1] = sch->Start[i] + count[i];
+    }
+
+    /* Fill in ascending Id order */
+    for (Uns16 i = 1; i <= PLANET_NR; ++i) {
+        if (planetStage[i] != SS_None) {
+            sch->Ids[fill[planetStage[i]]++] = i;
+        }
+    }
+    for (Uns16 i = 1; i <= SHIP_NR; ++i) {
+        if (shipStage[i] != SS_None) {
+            sch->Ids[fill[shipStage[i]]++] = i;
+        }
+        if (shipTagged[i]) {
+            sch->Ids[fill[SS_Tagged]++] = i;
+        }
+    }
+}
+
+struct ScheduleList Schedule_Get(const struct Schedule* sch, enum ScheduleStage stage)
+{
+    struct ScheduleList result = { NULL, 0 };
+    if (stage > SS_None && stage < SCHEDULE_STAGE_NR) {
+        result.Ids = &sch->Ids[sch->Start[stage]];
+        result.Count = sch->Start[stage+1] - sch->Start[stage];
+    }
+    return result;
+}
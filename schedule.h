@@ -0,0 +1,55 @@
+/**
+  *  \file schedule.h
+  *  \brief Starbase Reloaded - Work Lists
+  *
+  *  The schedule is built once per run from the snapshot.
+  *  For each stage, it lists the planets or ships that have something to do,
+  *  so that stages need not scan all objects.
+  */
+#ifndef SCHEDULE_H_INCLUDED
+#define SCHEDULE_H_INCLUDED
+
+#include <phostpdk.h>
+
+struct Snapshot;
+
+/** Work list identifier. */
+enum ScheduleStage {
+    SS_None,
+    SS_MineSweeping,            /**< Planets with SMF, MSC. */
+    SS_MineLaying,              /**< Planets with LMF, LWF. */
+    SS_ReceiveMoney,            /**< Planets with RMT. */
+    SS_TransferMoney,           /**< Planets with TMn. */
+    SS_SendConfig,              /**< Planets with con. */
+    SS_Unload,                  /**< Ships with UAP, UEn, UBn, UTn. */
+    SS_Load,                    /**< Ships with GEn, GBn, GTn. */
+    SS_Tagged,                  /**< Ships whose name starts with TRANSPORT_NAME_PREFIX. */
+    SCHEDULE_STAGE_NR
+};
+
+/** Work list. */
+struct ScheduleList {
+    const Uns16* Ids;           /**< Object Ids, sorted ascending. */
+    Uns16        Count;         /**< Number of elements in Ids. */
+};
+
+/** Schedule.
+    All lists are stored back-to-back in one array. */
+struct Schedule {
+    Uns16 Start[SCHEDULE_STAGE_NR+1];       /**< Start index of each list in Ids. */
+    Uns16 Ids[PLANET_NR + 2*SHIP_NR];       /**< Object Ids. */
+};
+
+/** Build schedule.
+    @param [out] sch Schedule
+    @param [in]  s   Snapshot with decoded friendly codes
+    @pre PDK has loaded host data (ReadHostData) */
+void Schedule_Build(struct Schedule* sch, const struct Snapshot* s);
+
+/** Get work list.
+    @param [in] sch   Schedule
+    @param [in] stage Work list identifier
+    @return List; valid as long as the schedule */
+struct ScheduleList Schedule_Get(const struct Schedule* sch, enum ScheduleStage stage);
+
+#endif
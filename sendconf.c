@@ -7,57 +7,45 @@
 #include "config.h"
 #include "language.h"
 #include "message.h"
+#include "snapshot.h"
 #include "util.h"
 
-struct State {
-    struct Message m;
-    RaceType_Def player;
-};
-
 static void State_SendOption(void* state, const char* name, const char* value)
 {
-    struct State* st = state;
-    if (st->m.Lines >= MAX_MESSAGE_LINES) {
-        const struct Language* lang = GetLanguageForPlayer(st->player);
-        Message_Add(&st->m, lang->Continuation);
-        Message_Send(&st->m, st->player);
-        Message_Init(&st->m);
-        Message_Add(&st->m, lang->SendConfig_Continuation);
-    }
-    Message_Add(&st->m, "  ");
-    Message_Add(&st->m, name);
-    Message_Add(&st->m, " = ");
-    Message_Add(&st->m, value);
-    Message_Add(&st->m, "\n");
+    struct Message* m = state;
+    Message_Add(m, "  ");
+    Message_Add(m, name);
+    Message_Add(m, " = ");
+    Message_Add(m, value);
+    Message_Add(m, "\n");
 }
 
 static void SendConfig(const struct Config* c, RaceType_Def player)
 {
-    struct State st;
     const struct Language* lang = GetLanguageForPlayer(player);
-    st.player = player;
-    Message_Init(&st.m);
-    Message_Add(&st.m, lang->SendConfig_Header);
-    Config_Format(c, State_SendOption, &st);
-    Message_Send(&st.m, st.player);
+    struct Message m, cont;
+    Message_Init(&m);
+    Message_Init(&cont);
+    Message_Add(&m, lang->SendConfig_Header);
+    Message_Add(&cont, lang->SendConfig_Continuation);
+    Config_Format(c, State_SendOption, &m);
+    Message_SendContinued(&m, &cont, player);
 }
 
 
-void DoSendConfig(const struct Config* c)
+void DoSendConfig(const struct Snapshot* s, const struct Config* c)
 {
     Info("    Sending configuration...");
 
     Uns32 gotConfig = 0;
-    for (Uns16 planetId = 1; planetId <= PLANET_NR; ++planetId) {
-        if (IsPlanetExist(planetId)) {
-            RaceType_Def owner = PlanetOwner(planetId);
-            if ((owner != 0) && (owner <= RACE_NR) && (gotConfig & (1 << owner)) == 0) {
-                if (PlanetHasFCode(planetId, "con")) {
-                    gotConfig |= 1 << owner;
-                    Info("\t(+) Player %d: requested configuration", owner);
-                    SendConfig(c, owner);
-                }
-            }
+    const struct ScheduleList list = Schedule_Get(&s->Schedule, SS_SendConfig);
+    for (Uns16 n = 0; n < list.Count; ++n) {
+        const Uns16 planetId = list.Ids[n];
+        RaceType_Def owner = s->Planets.Owner[planetId];
+        if ((owner != 0) && (owner <= RACE_NR) && (gotConfig & (1 << owner)) == 0) {
+            gotConfig |= 1 << owner;
+            Info("\t(+) Player %d: requested configuration", owner);
+            SendConfig(c, owner);
         }
     }
 }
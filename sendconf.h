@@ -6,9 +6,11 @@
 #define SENDCONF_H_INCLUDED
 
 struct Config;
+struct Snapshot;
 
 /** Send configuration to players who requested it ("con" fcode).
+    @param [in] s Game snapshot
     @param [in] c Configuration */
-void DoSendConfig(const struct Config* c);
+void DoSendConfig(const struct Snapshot* s, const struct Config* c);
 
 #endif
@@ -0,0 +1,432 @@
+/**
+  *  \file snapshot.c
+  *  \brief Starbase Reloaded - In-Memory Game Snapshot
+  */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "snapshot.h"
+#include "hostdata.h"
+#include "util.h"
+
+/* Modification flags */
+enum {
+    MOD_PlanetCredits    = 1,
+    MOD_BaseTorps        = 1,
+    MOD_BaseEngines      = 2,
+    MOD_BaseBeams        = 4,
+    MOD_BaseTubes        = 8,
+    MOD_ShipCargo        = 1,
+    MOD_MinefieldUnits   = 1
+};
+
+/* Mapping of enum ShipCargo to PDK cargo types (except SC_Ammo) */
+static const CargoType_Def SHIP_CARGO_TYPES[SC_Ammo] = {
+    TRITANIUM,
+    DURANIUM,
+    MOLYBDENUM,
+    SUPPLIES,
+    COLONISTS
+};
+
+
+/*
+ *  Loading
+ */
+
+static Uns8 DecodeFCode(const char* fc, enum FCodeTarget target, Uns8* arg)
+{
+    Uns16 value;
+    enum FCodeAction action = FCode_Decode(fc, target, &value);
+    *arg = (Uns8) value;
+    return (Uns8) action;
+}
+
+static void LoadPlanets(struct SnapshotPlanets* p)
+{
+    memset(p, 0, sizeof(*p));
+    for (Uns16 i = 1; i <= PLANET_NR; ++i) {
+        if (IsPlanetExist(i)) {
+            p->Exists[i]  = True;
+            p->Owner[i]   = PlanetOwner(i);
+            p->X[i]       = PlanetLocationX(i);
+            p->Y[i]       = PlanetLocationY(i);
+            p->Credits[i] = PlanetCargo(i, CREDITS);
+            PlanetFCode(i, p->FCode[i]);
+            p->Action[i]  = DecodeFCode(p->FCode[i], FCT_Planet, &p->ActionArg[i]);
+        }
+    }
+}
+
+static void LoadBases(struct SnapshotBases* p)
+{
+    memset(p, 0, sizeof(*p));
+    for (Uns16 i = 1; i <= PLANET_NR; ++i) {
+        if (IsBaseExist(i)) {
+            p->Exists[i]     = True;
+            p->Owner[i]      = BaseOwner(i);
+            p->HullTech[i]   = BaseTech(i, HULL_TECH);
+            p->EngineTech[i] = BaseTech(i, ENGINE_TECH);
+            p->BeamTech[i]   = BaseTech(i, BEAM_TECH);
+            p->TorpTech[i]   = BaseTech(i, TORP_TECH);
+            p->Defense[i]    = BaseDefense(i);
+            p->Fighters[i]   = BaseFighters(i);
+            for (Uns16 j = 1; j <= TORP_NR; ++j) {
+                p->Torps[i][j-1] = BaseTorps(i, j);
+                p->Tubes[i][j-1] = BaseTubes(i, j);
+            }
+            for (Uns16 j = 1; j <= ENGINE_NR; ++j) {
+                p->Engines[i][j-1] = BaseEngines(i, j);
+            }
+            for (Uns16 j = 1; j <= BEAM_NR; ++j) {
+                p->Beams[i][j-1] = BaseBeams(i, j);
+            }
+        }
+    }
+}
+
+static void LoadShips(struct SnapshotShips* p)
+{
+    memset(p, 0, sizeof(*p));
+    for (Uns16 i = 1; i <= SHIP_NR; ++i) {
+        if (IsShipExist(i)) {
+            p->Exists[i]   = True;
+            p->Owner[i]    = ShipOwner(i);
+            p->X[i]        = ShipLocationX(i);
+            p->Y[i]        = ShipLocationY(i);
+            p->Hull[i]     = ShipHull(i);
+            p->NumBeams[i] = ShipBeamNumber(i);
+            p->NumTubes[i] = ShipTubeNumber(i);
+            p->NumBays[i]  = ShipBays(i);
+            p->CanCloak[i] = ShipCanCloak(i);
+            ShipFCode(i, p->FCode[i]);
+            p->Action[i]   = DecodeFCode(p->FCode[i], FCT_Ship, &p->ActionArg[i]);
+            for (int j = 0; j < SC_Ammo; ++j) {
+                p->Cargo[i][j] = ShipCargo(i, SHIP_CARGO_TYPES[j]);
+            }
+            p->Cargo[i][SC_Ammo] = ShipAmmunition(i);
+        }
+    }
+}
+
+static void LoadMinefield(struct SnapshotMinefields* p, Uns16 i)
+{
+    p->Exists[i] = True;
+    p->Owner[i]  = MinefieldOwner(i);
+    p->X[i]      = MinefieldPositionX(i);
+    p->Y[i]      = MinefieldPositionY(i);
+    p->Units[i]  = MinefieldUnits(i);
+    p->IsWeb[i]  = IsMinefieldWeb(i);
+}
+
+static void IndexMinefield(struct SnapshotMinefields* p, Uns16 i)
+{
+    if (p->Exists[i] && p->Units[i] > 0) {
+        MineIndex_Add(&p->Index, i, p->Owner[i], p->X[i], p->Y[i], (Uns16) sqrt((double) p->Units[i]));
+    }
+}
+
+static void LoadMinefields(struct SnapshotMinefields* p)
+{
+    memset(p, 0, sizeof(*p));
+    MineIndex_Init(&p->Index);
+    for (Uns16 i = 1; i <= MINE_NR; ++i) {
+        if (IsMinefieldExist(i)) {
+            LoadMinefield(p, i);
+            IndexMinefield(p, i);
+        }
+    }
+}
+
+static void IndexBases(struct Snapshot* s)
+{
+    struct BaseIndex* idx = &s->Bases.Index;
+    BaseIndex_Init(idx);
+    for (Uns16 i = 1; i <= PLANET_NR; ++i) {
+        if (s->Bases.Exists[i]) {
+            BaseIndex_AddBase(idx, i, s->Planets.X[i], s->Planets.Y[i]);
+        }
+    }
+    for (Uns16 i = 1; i <= SHIP_NR; ++i) {
+        if (s->Ships.Exists[i]) {
+            BaseIndex_AddShip(idx, i, s->Ships.X[i], s->Ships.Y[i]);
+        }
+    }
+}
+
+void Snapshot_Load(struct Snapshot* s)
+{
+    LoadPlanets(&s->Planets);
+    LoadBases(&s->Bases);
+    LoadShips(&s->Ships);
+    IndexBases(s);
+    LoadMinefields(&s->Minefields);
+    Schedule_Build(&s->Schedule, s);
+    Alliances_Init(&s->Alliances);
+}
+
+
+/*
+ *  Write-back
+ */
+
+static void CommitPlanets(struct SnapshotPlanets* p)
+{
+    for (Uns16 i = 1; i <= PLANET_NR; ++i) {
+        if (p->Modified[i] & MOD_PlanetCredits) {
+            HostData_PutPlanetCargo(i, CREDITS, p->Credits[i]);
+        }
+        p->Modified[i] = 0;
+    }
+}
+
+static void CommitBases(struct SnapshotBases* p)
+{
+    for (Uns16 i = 1; i <= PLANET_NR; ++i) {
+        const Uns8 mod = p->Modified[i];
+        if (mod != 0) {
+            for (Uns16 j = 1; j <= TORP_NR; ++j) {
+                if (mod & MOD_BaseTorps) {
+                    HostData_PutBaseTorps(i, j, p->Torps[i][j-1]);
+                }
+                if (mod & MOD_BaseTubes) {
+                    HostData_PutBaseTubes(i, j, p->Tubes[i][j-1]);
+                }
+            }
+            if (mod & MOD_BaseEngines) {
+                for (Uns16 j = 1; j <= ENGINE_NR; ++j) {
+                    HostData_PutBaseEngines(i, j, p->Engines[i][j-1]);
+                }
+            }
+            if (mod & MOD_BaseBeams) {
+                for (Uns16 j = 1; j <= BEAM_NR; ++j) {
+                    HostData_PutBaseBeams(i, j, p->Beams[i][j-1]);
+                }
+            }
+            p->Modified[i] = 0;
+        }
+    }
+}
+
+static void CommitShips(struct SnapshotShips* p)
+{
+    for (Uns16 i = 1; i <= SHIP_NR; ++i) {
+        if (p->Modified[i] & MOD_ShipCargo) {
+            for (int j = 0; j < SC_Ammo; ++j) {
+                HostData_PutShipCargo(i, SHIP_CARGO_TYPES[j], p->Cargo[i][j]);
+            }
+            HostData_PutShipAmmunition(i, p->Cargo[i][SC_Ammo]);
+        }
+        p->Modified[i] = 0;
+    }
+}
+
+static void CommitMinefields(struct SnapshotMinefields* p)
+{
+    for (Uns16 i = 1; i <= MINE_NR; ++i) {
+        if (p->Modified[i] & MOD_MinefieldUnits) {
+            HostData_PutMinefieldUnits(i, p->Units[i]);
+        }
+        p->Modified[i] = 0;
+    }
+}
+
+void Snapshot_Commit(struct Snapshot* s)
+{
+    CommitPlanets(&s->Planets);
+    CommitBases(&s->Bases);
+    CommitShips(&s->Ships);
+    CommitMinefields(&s->Minefields);
+}
+
+
+/*
+ *  Planets and Bases
+ */
+
+void Snapshot_PutPlanetCredits(struct Snapshot* s, Uns16 planetId, Uns32 amount)
+{
+    if (planetId > 0 && planetId <= PLANET_NR && s->Planets.Credits[planetId] != amount) {
+        s->Planets.Credits[planetId] = amount;
+        s->Planets.Modified[planetId] |= MOD_PlanetCredits;
+    }
+}
+
+void Snapshot_PutBaseTorps(struct Snapshot* s, Uns16 planetId, Uns16 torpNr, Uns16 amount)
+{
+    if (planetId > 0 && planetId <= PLANET_NR && torpNr > 0 && torpNr <= TORP_NR && s->Bases.Torps[planetId][torpNr-1] != amount) {
+        s->Bases.Torps[planetId][torpNr-1] = amount;
+        s->Bases.Modified[planetId] |= MOD_BaseTorps;
+    }
+}
+
+Uns16 Snapshot_BaseComponents(const struct Snapshot* s, Uns16 planetId, BaseTech_Def type, Uns16 slot)
+{
+    Uns16 result = 0;
+    if (planetId > 0 && planetId <= PLANET_NR) {
+        switch (type) {
+         case ENGINE_TECH: result = (slot > 0 && slot <= ENGINE_NR ? s->Bases.Engines[planetId][slot-1] : 0); break;
+         case BEAM_TECH:   result = (slot > 0 && slot <= BEAM_NR   ? s->Bases.Beams[planetId][slot-1]   : 0); break;
+         case TORP_TECH:   result = (slot > 0 && slot <= TORP_NR   ? s->Bases.Tubes[planetId][slot-1]   : 0); break;
+         default:;
+        }
+    }
+    return result;
+}
+
+void Snapshot_PutBaseComponents(struct Snapshot* s, Uns16 planetId, BaseTech_Def type, Uns16 slot, Uns16 amount)
+{
+    Uns16* p = 0;
+    Uns8 mod = 0;
+    if (planetId > 0 && planetId <= PLANET_NR) {
+        switch (type) {
+         case ENGINE_TECH:
+            if (slot > 0 && slot <= ENGINE_NR) {
+                p = &s->Bases.Engines[planetId][slot-1];
+                mod = MOD_BaseEngines;
+            }
+            break;
+         case BEAM_TECH:
+            if (slot > 0 && slot <= BEAM_NR) {
+                p = &s->Bases.Beams[planetId][slot-1];
+                mod = MOD_BaseBeams;
+            }
+            break;
+         case TORP_TECH:
+            if (slot > 0 && slot <= TORP_NR) {
+                p = &s->Bases.Tubes[planetId][slot-1];
+                mod = MOD_BaseTubes;
+            }
+            break;
+         default:;
+        }
+    }
+    if (p != 0 && *p != amount) {
+        *p = amount;
+        s->Bases.Modified[planetId] |= mod;
+    }
+}
+
+
+/*
+ *  Ships
+ */
+
+Uns16 Snapshot_ShipBase(const struct Snapshot* s, Uns16 shipId)
+{
+    return BaseIndex_ShipBase(&s->Bases.Index, shipId);
+}
+
+Uns16 Snapshot_FirstShipAtBase(const struct Snapshot* s, Uns16 planetId)
+{
+    return BaseIndex_FirstShip(&s->Bases.Index, planetId);
+}
+
+Uns16 Snapshot_NextShipAtBase(const struct Snapshot* s, Uns16 shipId)
+{
+    return BaseIndex_NextShip(&s->Bases.Index, shipId);
+}
+
+Uns16 Snapshot_ShipCargoMass(const struct Snapshot* s, Uns16 shipId)
+{
+    Uns16 total = 0;
+    if (shipId > 0 && shipId <= SHIP_NR) {
+        for (int i = 0; i < SHIP_CARGO_NR; ++i) {
+            total += s->Ships.Cargo[shipId][i];
+        }
+    }
+    return total;
+}
+
+void Snapshot_PutShipCargo(struct Snapshot* s, Uns16 shipId, enum ShipCargo what, Uns16 amount)
+{
+    if (shipId > 0 && shipId <= SHIP_NR && what < SHIP_CARGO_NR && s->Ships.Cargo[shipId][what] != amount) {
+        s->Ships.Cargo[shipId][what] = amount;
+        s->Ships.Modified[shipId] |= MOD_ShipCargo;
+    }
+}
+
+
+/*
+ *  Minefields
+ */
+
+Uns16 Snapshot_MinefieldRadius(const struct Snapshot* s, Uns16 mineId)
+{
+    return (mineId > 0 && mineId <= MINE_NR
+            ? (Uns16) sqrt((double) s->Minefields.Units[mineId])
+            : 0);
+}
+
+void Snapshot_PutMinefieldUnits(struct Snapshot* s, Uns16 mineId, Uns32 units)
+{
+    struct SnapshotMinefields* p = &s->Minefields;
+    if (mineId > 0 && mineId <= MINE_NR && p->Units[mineId] != units) {
+        const Uns32 oldUnits = p->Units[mineId];
+        p->Units[mineId] = units;
+        p->Modified[mineId] |= MOD_MinefieldUnits;
+
+        // Update index
+        if (units == 0) {
+            MineIndex_Remove(&p->Index, mineId, p->Owner[mineId], p->X[mineId], p->Y[mineId]);
+        } else if (oldUnits == 0) {
+            IndexMinefield(p, mineId);
+        } else {
+            MineIndex_UpdateRadius(&p->Index, p->Owner[mineId], Snapshot_MinefieldRadius(s, mineId));
+        }
+    }
+}
+
+Uns16 Snapshot_CreateMinefield(struct Snapshot* s, Uns16 x, Uns16 y, RaceType_Def owner, Uns32 units, Boolean isWeb)
+{
+    Uns16 mineId = HostData_CreateMinefield(x, y, owner, units, isWeb);
+    if (mineId > 0 && mineId <= MINE_NR) {
+        LoadMinefield(&s->Minefields, mineId);
+        IndexMinefield(&s->Minefields, mineId);
+        s->Minefields.Modified[mineId] = 0;
+    }
+    return mineId;
+}
+
+static int CompareIds(const void* a, const void* b)
+{
+    const Uns16 pa = *(const Uns16*) a;
+    const Uns16 pb = *(const Uns16*) b;
+    return (pa > pb) - (pa < pb);
+}
+
+void Snapshot_EnumerateMinesWithinRadius(const struct Snapshot* s, Uns16 x, Uns16 y, Uns16 range, Uns32 ownerMask, Uns16* result)
+{
+    const struct SnapshotMinefields* p = &s->Minefields;
+    const Uns32 maxDist = (Uns32) range * range;
+    const Uns16 numCandidates = MineIndex_FindCandidates(&p->Index, x, y, range, ownerMask, result);
+    size_t n = 0;
+    for (Uns16 k = 0; k < numCandidates; ++k) {
+        const Uns16 i = result[k];
+        if (p->Units[i] > 0 && MapDistanceSquared(x, y, p->X[i], p->Y[i]) <= maxDist) {
+            result[n++] = i;
+        }
+    }
+    qsort(result, n, sizeof(*result), CompareIds);
+    result[n] = 0;
+}
+
+void Snapshot_EnumerateMinesCovering(const struct Snapshot* s, Uns16 x, Uns16 y, Uns32 ownerMask, Uns16* result)
+{
+    const struct SnapshotMinefields* p = &s->Minefields;
+    const Uns16 maxRadius = MineIndex_MaxRadius(&p->Index, ownerMask);
+    const Uns16 numCandidates = MineIndex_FindCandidates(&p->Index, x, y, maxRadius, ownerMask, result);
+    size_t n = 0;
+    for (Uns16 k = 0; k < numCandidates; ++k) {
+        const Uns16 i = result[k];
+        if (p->Units[i] > 0) {
+            const Uns32 radius = Snapshot_MinefieldRadius(s, i);
+            if (MapDistanceSquared(x, y, p->X[i], p->Y[i]) <= radius*radius) {
+                result[n++] = i;
+            }
+        }
+    }
+    qsort(result, n, sizeof(*result), CompareIds);
+    result[n] = 0;
+}
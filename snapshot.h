@@ -0,0 +1,227 @@
+/**
+  *  \file snapshot.h
+  *  \brief Starbase Reloaded - In-Memory Game Snapshot
+  *
+  *  All stages work on a copy of the game data they need, taken once
+  *  after the PDK has loaded the host data. Data is stored as structure
+  *  of arrays; every array is indexed by object Id (element 0 is unused).
+  *
+  *  Stages read the arrays directly, but must modify them only using the
+  *  Snapshot_Put... functions, which track modifications.
+  *  Snapshot_Commit() writes back all modified fields using the PDK.
+  */
+#ifndef SNAPSHOT_H_INCLUDED
+#define SNAPSHOT_H_INCLUDED
+
+#include <phostpdk.h>
+#include "fcode.h"
+#include "schedule.h"
+#include "mineindex.h"
+#include "baseindex.h"
+#include "alliance.h"
+#include "profile.h"
+
+/** Ship cargo types, in the order used for trimming. */
+enum ShipCargo {
+    SC_Tritanium,
+    SC_Duranium,
+    SC_Molybdenum,
+    SC_Supplies,
+    SC_Colonists,
+    SC_Ammo,                    /**< Torpedoes or fighters. */
+    SHIP_CARGO_NR
+};
+
+/** Planets. */
+struct SnapshotPlanets {
+    Boolean      Exists[PLANET_NR+1];
+    RaceType_Def Owner[PLANET_NR+1];
+    Uns16        X[PLANET_NR+1];
+    Uns16        Y[PLANET_NR+1];
+    char         FCode[PLANET_NR+1][3];
+    Uns8         Action[PLANET_NR+1];        /**< Decoded friendly code (enum FCodeAction). */
+    Uns8         ActionArg[PLANET_NR+1];     /**< Decoded friendly code argument. */
+    Uns32        Credits[PLANET_NR+1];
+    Uns8         Modified[PLANET_NR+1];      /**< Internal: modification flags. */
+};
+
+/** Starbases. Indexed by planet Id. */
+struct SnapshotBases {
+    Boolean      Exists[PLANET_NR+1];
+    RaceType_Def Owner[PLANET_NR+1];
+    Uns16        HullTech[PLANET_NR+1];
+    Uns16        EngineTech[PLANET_NR+1];
+    Uns16        BeamTech[PLANET_NR+1];
+    Uns16        TorpTech[PLANET_NR+1];
+    Uns16        Defense[PLANET_NR+1];
+    Uns16        Fighters[PLANET_NR+1];
+    Uns16        Torps[PLANET_NR+1][TORP_NR];       /**< Torpedo storage. Indexed by Id-1. */
+    Uns16        Engines[PLANET_NR+1][ENGINE_NR];   /**< Engine storage. Indexed by Id-1. */
+    Uns16        Beams[PLANET_NR+1][BEAM_NR];       /**< Beam storage. Indexed by Id-1. */
+    Uns16        Tubes[PLANET_NR+1][TORP_NR];       /**< Torpedo launcher storage. Indexed by Id-1. */
+    Uns8         Modified[PLANET_NR+1];             /**< Internal: modification flags. */
+    struct BaseIndex Index;                         /**< Internal: location index of all bases, and ships at them. */
+};
+
+/** Ships. */
+struct SnapshotShips {
+    Boolean      Exists[SHIP_NR+1];
+    RaceType_Def Owner[SHIP_NR+1];
+    Uns16        X[SHIP_NR+1];
+    Uns16        Y[SHIP_NR+1];
+    char         FCode[SHIP_NR+1][3];
+    Uns8         Action[SHIP_NR+1];        /**< Decoded friendly code (enum FCodeAction). */
+    Uns8         ActionArg[SHIP_NR+1];     /**< Decoded friendly code argument. */
+    Uns16        Hull[SHIP_NR+1];
+    Uns16        NumBeams[SHIP_NR+1];
+    Uns16        NumTubes[SHIP_NR+1];
+    Uns16        NumBays[SHIP_NR+1];
+    Boolean      CanCloak[SHIP_NR+1];
+    Uns16        Cargo[SHIP_NR+1][SHIP_CARGO_NR];   /**< Cargo. Indexed by enum ShipCargo. */
+    Uns8         Modified[SHIP_NR+1];               /**< Internal: modification flags. */
+};
+
+/** Minefields. */
+struct SnapshotMinefields {
+    Boolean      Exists[MINE_NR+1];
+    RaceType_Def Owner[MINE_NR+1];
+    Uns16        X[MINE_NR+1];
+    Uns16        Y[MINE_NR+1];
+    Uns32        Units[MINE_NR+1];
+    Boolean      IsWeb[MINE_NR+1];
+    Uns8         Modified[MINE_NR+1];      /**< Internal: modification flags. */
+    struct MineIndex Index;                /**< Internal: location index of all nonempty minefields. */
+};
+
+/** Game snapshot. */
+struct Snapshot {
+    struct SnapshotPlanets    Planets;
+    struct SnapshotBases      Bases;
+    struct SnapshotShips      Ships;
+    struct SnapshotMinefields Minefields;
+    struct Schedule           Schedule;      /**< Work lists, built from the above. */
+    struct Alliances          Alliances;     /**< Alliance permissions. */
+    struct Profiles           Profiles;      /**< Derived data; built by Profiles_Build() after loading. */
+};
+
+/** Load snapshot.
+    @param [out] s Snapshot
+    @pre PDK has loaded host data (ReadHostData) */
+void Snapshot_Load(struct Snapshot* s);
+
+/** Write back all modified fields.
+    @param [in,out] s Snapshot; modification flags will be reset */
+void Snapshot_Commit(struct Snapshot* s);
+
+/*
+ *  Planets and Bases
+ */
+
+/** Set planet's money.
+    @param [in,out] s        Snapshot
+    @param [in]     planetId Planet Id
+    @param [in]     amount   New amount */
+void Snapshot_PutPlanetCredits(struct Snapshot* s, Uns16 planetId, Uns32 amount);
+
+/** Set base torpedo storage.
+    @param [in,out] s        Snapshot
+    @param [in]     planetId Planet Id
+    @param [in]     torpNr   Torpedo type (1-based)
+    @param [in]     amount   New amount */
+void Snapshot_PutBaseTorps(struct Snapshot* s, Uns16 planetId, Uns16 torpNr, Uns16 amount);
+
+/** Get base component storage.
+    @param [in] s        Snapshot
+    @param [in] planetId Planet Id
+    @param [in] type     Component type (ENGINE_TECH, BEAM_TECH, TORP_TECH)
+    @param [in] slot     Component slot (1-based)
+    @return Number of components; 0 if parameters invalid or out of range */
+Uns16 Snapshot_BaseComponents(const struct Snapshot* s, Uns16 planetId, BaseTech_Def type, Uns16 slot);
+
+/** Set base component storage.
+    @param [in,out] s        Snapshot
+    @param [in]     planetId Planet Id
+    @param [in]     type     Component type (ENGINE_TECH, BEAM_TECH, TORP_TECH)
+    @param [in]     slot     Component slot (1-based)
+    @param [in]     amount   New amount */
+void Snapshot_PutBaseComponents(struct Snapshot* s, Uns16 planetId, BaseTech_Def type, Uns16 slot, Uns16 amount);
+
+/*
+ *  Ships
+ */
+
+/** Get starbase at ship's position.
+    @param [in] s      Snapshot
+    @param [in] shipId Ship Id
+    @return Planet Id of a planet with starbase; 0 if none */
+Uns16 Snapshot_ShipBase(const struct Snapshot* s, Uns16 shipId);
+
+/** Enumerate ships at a starbase: get first ship.
+    Ships are returned in ascending Id order.
+    @param [in] s        Snapshot
+    @param [in] planetId Planet Id
+    @return Ship Id; 0 if none */
+Uns16 Snapshot_FirstShipAtBase(const struct Snapshot* s, Uns16 planetId);
+
+/** Enumerate ships at a starbase: get next ship.
+    @param [in] s      Snapshot
+    @param [in] shipId Ship Id, as returned by Snapshot_FirstShipAtBase() or Snapshot_NextShipAtBase()
+    @return Ship Id; 0 if none */
+Uns16 Snapshot_NextShipAtBase(const struct Snapshot* s, Uns16 shipId);
+
+/** Get ship's cargo mass.
+    @param [in] s      Snapshot
+    @param [in] shipId Ship Id
+    @return Total mass of all cargo (not including fuel) */
+Uns16 Snapshot_ShipCargoMass(const struct Snapshot* s, Uns16 shipId);
+
+/** Set ship cargo.
+    @param [in,out] s      Snapshot
+    @param [in]     shipId Ship Id
+    @param [in]     what   Cargo type
+    @param [in]     amount New amount */
+void Snapshot_PutShipCargo(struct Snapshot* s, Uns16 shipId, enum ShipCargo what, Uns16 amount);
+
+/*
+ *  Minefields
+ */
+
+/** Get minefield radius.
+    @param [in] s      Snapshot
+    @param [in] mineId Minefield Id
+    @return Radius */
+Uns16 Snapshot_MinefieldRadius(const struct Snapshot* s, Uns16 mineId);
+
+/** Set minefield units.
+    @param [in,out] s      Snapshot
+    @param [in]     mineId Minefield Id
+    @param [in]     units  New number of units */
+void Snapshot_PutMinefieldUnits(struct Snapshot* s, Uns16 mineId, Uns32 units);
+
+/** Create minefield.
+    The minefield is created in the PDK immediately (to allocate an Id) and added to the snapshot.
+    @param [in,out] s      Snapshot
+    @param [in]     x,y    Position
+    @param [in]     owner  Owner
+    @param [in]     units  Number of units
+    @param [in]     isWeb  True to create a web minefield
+    @return Minefield Id; 0 on failure */
+Uns16 Snapshot_CreateMinefield(struct Snapshot* s, Uns16 x, Uns16 y, RaceType_Def owner, Uns32 units, Boolean isWeb);
+
+/** Enumerate minefields within radius.
+    Returns all nonempty minefields whose center is within the given distance of the given point.
+    @param [in]  s         Snapshot
+    @param [in]  x,y       Position
+    @param [in]  range     Maximum distance
+    @param [in]  ownerMask Owners to consider (bit N set for owner N; see MINEINDEX_ALL_OWNERS)
+    @param [out] result    Minefield Ids (sorted ascending), terminated by 0; must have room for MINE_NR+1 elements */
+void Snapshot_EnumerateMinesWithinRadius(const struct Snapshot* s, Uns16 x, Uns16 y, Uns16 range, Uns32 ownerMask, Uns16* result);
+
+/** Enumerate minefields covering a point.
+    @param [in]  s         Snapshot
+    @param [in]  x,y       Position
+    @param [in]  ownerMask Owners to consider (bit N set for owner N; see MINEINDEX_ALL_OWNERS)
+    @param [out] result    Minefield Ids (sorted ascending), terminated by 0; must have room for MINE_NR+1 elements */
+void Snapshot_EnumerateMinesCovering(const struct Snapshot* s, Uns16 x, Uns16 y, Uns32 ownerMask, Uns16* result);
+
+#endif
@@ -0,0 +1,292 @@
+/**
+  *  \file statefile.c
+  *  \brief Starbase Reloaded - Crash-Safe State File Access
+  */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "statefile.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+# define HAVE_POSIX_IO 1
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+#else
+# define HAVE_POSIX_IO 0
+#endif
+
+/* Suffix for temporary files. */
+static const char*const TEMP_SUFFIX = ".new";
+
+/* Maximum number of files staged at a time. */
+#define MAX_STAGED 4
+
+/* Staged files: final name and temporary name, both complete paths. */
+static struct {
+    char* FileName;
+    char* TempName;
+} gStaged[MAX_STAGED];
+static int gNumStaged;
+
+/* Number of bytes that can still be written, see StateFile_SetWriteLimit(); negative for no limit. */
+static long gWriteLimit = -1;
+
+/* Make path name in game directory. Result is allocated with malloc(). */
+static char* MakePath(const char* name, const char* suffix)
+{
+    const char* dir = (gGameDirectory != NULL ? gGameDirectory : "");
+    const size_t dirLen = strlen(dir);
+    const Boolean needSep = (dirLen != 0 && dir[dirLen-1] != '/' && dir[dirLen-1] != '\\');
+    char* result = malloc(dirLen + 1 + strlen(name) + strlen(suffix) + 1);
+    if (result == NULL) {
+        ErrorExit("Out of memory");
+    }
+    sprintf(result, "%s%s%s%s", dir, needSep ? "/" : "", name, suffix);
+    return result;
+}
+
+/* Apply write limit to a write request. Returns the number of bytes that can be written. */
+static size_t LimitWrite(size_t size)
+{
+    if (gWriteLimit >= 0) {
+        if ((size_t) gWriteLimit < size) {
+            size = gWriteLimit;
+        }
+        gWriteLimit -= size;
+    }
+    return size;
+}
+
+#if HAVE_POSIX_IO
+/* Write complete buffer to file descriptor. */
+static Boolean WriteAll(int fd, const Uns8* data, size_t size)
+{
+    const size_t permitted = LimitWrite(size);
+    const Boolean complete = (permitted == size);
+    size = permitted;
+    while (size > 0) {
+        const ssize_t n = write(fd, data, size);
+        if (n <= 0) {
+            return False;
+        }
+        data += n;
+        size -= n;
+    }
+    return complete;
+}
+
+/* Flush directory containing a file, to make a rename durable. */
+static void SyncDirectory(void)
+{
+    int fd = open(gGameDirectory != NULL && gGameDirectory[0] != '\0' ? gGameDirectory : ".", O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+#endif
+
+/*
+ *  Reading
+ */
+
+Boolean StateFile_Open(struct StateFile* sf, const char* name)
+{
+    char* path = MakePath(name, "");
+    sf->Data = NULL;
+    sf->Size = 0;
+    sf->Mapping = NULL;
+    sf->Buffer = NULL;
+
+#if HAVE_POSIX_IO
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        free(path);
+        return False;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ErrorExit("Unable to read file (%s)", name);
+    }
+    sf->Size = st.st_size;
+    if (sf->Size != 0) {
+        void* p = mmap(NULL, sf->Size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            ErrorExit("Unable to read file (%s)", name);
+        }
+        sf->Mapping = p;
+        sf->Data = p;
+    }
+    close(fd);
+#else
+    FILE* f = fopen(path, "rb");
+    if (f == NULL) {
+        free(path);
+        return False;
+    }
+    long size;
+    if (fseek(f, 0, SEEK_END) != 0 || (size = ftell(f)) < 0 || fseek(f, 0, SEEK_SET) != 0) {
+        ErrorExit("Unable to read file (%s)", name);
+    }
+    sf->Size = size;
+    sf->Buffer = malloc(sf->Size + 1);
+    if (sf->Buffer == NULL) {
+        ErrorExit("Out of memory");
+    }
+    if (fread(sf->Buffer, 1, sf->Size, f) != sf->Size) {
+        ErrorExit("Unable to read file (%s)", name);
+    }
+    sf->Data = sf->Buffer;
+    fclose(f);
+#endif
+
+    free(path);
+    return True;
+}
+
+void StateFile_Close(struct StateFile* sf)
+{
+#if HAVE_POSIX_IO
+    if (sf->Mapping != NULL) {
+        munmap(sf->Mapping, sf->Size);
+    }
+#endif
+    free(sf->Buffer);
+    sf->Data = NULL;
+    sf->Size = 0;
+    sf->Mapping = NULL;
+    sf->Buffer = NULL;
+}
+
+/*
+ *  Writing
+ */
+
+void StateFile_Stage(const char* name, const void* data, size_t size)
+{
+    // Find slot; re-staging a file replaces the previous content.
+    char* fileName = MakePath(name, "");
+    int slot = 0;
+    while (slot < gNumStaged && strcmp(gStaged[slot].FileName, fileName) != 0) {
+        ++slot;
+    }
+    if (slot == gNumStaged) {
+        if (gNumStaged >= MAX_STAGED) {
+            ErrorExit("Too many state files");
+        }
+        gStaged[slot].FileName = fileName;
+        gStaged[slot].TempName = MakePath(name, TEMP_SUFFIX);
+        ++gNumStaged;
+    } else {
+        free(fileName);
+    }
+    const char* tempName = gStaged[slot].TempName;
+
+    // Write and flush temporary file
+#if HAVE_POSIX_IO
+    int fd = open(tempName, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    Boolean ok = (fd >= 0);
+    if (ok) {
+        ok = WriteAll(fd, data, size);
+        if (fsync(fd) != 0) {
+            ok = False;
+        }
+        if (close(fd) != 0) {
+            ok = False;
+        }
+    }
+#else
+    FILE* f = fopen(tempName, "wb");
+    Boolean ok = (f != NULL);
+    if (ok) {
+        const size_t permitted = LimitWrite(size);
+        ok = (fwrite(data, 1, permitted, f) == size);
+        if (fflush(f) != 0) {
+            ok = False;
+        }
+        if (fclose(f) != 0) {
+            ok = False;
+        }
+    }
+#endif
+    if (!ok) {
+        StateFile_Discard();
+        ErrorExit("Unable to write state file (%s)", name);
+    }
+}
+
+void StateFile_Append(const char* name, const void* data, size_t size)
+{
+    char* path = MakePath(name, "");
+#if HAVE_POSIX_IO
+    int fd = open(path, O_WRONLY | O_APPEND | O_CREAT, 0666);
+    Boolean ok = (fd >= 0);
+    if (ok) {
+        ok = WriteAll(fd, data, size);
+        if (fsync(fd) != 0) {
+            ok = False;
+        }
+        if (close(fd) != 0) {
+            ok = False;
+        }
+    }
+#else
+    FILE* f = fopen(path, "ab");
+    Boolean ok = (f != NULL);
+    if (ok) {
+        const size_t permitted = LimitWrite(size);
+        ok = (fwrite(data, 1, permitted, f) == size);
+        if (fclose(f) != 0) {
+            ok = False;
+        }
+    }
+#endif
+    free(path);
+    if (!ok) {
+        ErrorExit("Unable to write state file (%s)", name);
+    }
+}
+
+Boolean StateFile_Commit(void)
+{
+    Boolean ok = True;
+    for (int i = 0; i < gNumStaged; ++i) {
+#if !HAVE_POSIX_IO
+        // Non-POSIX rename() refuses to overwrite.
+        remove(gStaged[i].FileName);
+#endif
+        if (rename(gStaged[i].TempName, gStaged[i].FileName) != 0) {
+            Warning("Unable to replace state file (%s)", gStaged[i].FileName);
+            remove(gStaged[i].TempName);
+            ok = False;
+        }
+        free(gStaged[i].FileName);
+        free(gStaged[i].TempName);
+    }
+#if HAVE_POSIX_IO
+    if (gNumStaged != 0) {
+        SyncDirectory();
+    }
+#endif
+    gNumStaged = 0;
+    return ok;
+}
+
+void StateFile_Discard(void)
+{
+    for (int i = 0; i < gNumStaged; ++i) {
+        remove(gStaged[i].TempName);
+        free(gStaged[i].FileName);
+        free(gStaged[i].TempName);
+    }
+    gNumStaged = 0;
+}
+
+void StateFile_SetWriteLimit(long limit)
+{
+    gWriteLimit = limit;
+}
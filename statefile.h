@@ -0,0 +1,75 @@
+/**
+  *  \file statefile.h
+  *  \brief Starbase Reloaded - Crash-Safe State File Access
+  *
+  *  State files are read through a read-only memory mapping where available.
+  *
+  *  State files are never overwritten in place. StateFile_Stage() writes
+  *  the new content to a temporary file and flushes it to disk;
+  *  StateFile_Commit() then atomically replaces the original files.
+  *  The main program commits only after the host data has been written
+  *  successfully, so a failure at any point leaves the previous state
+  *  file intact.
+  *
+  *  StateFile_Append() is not part of this scheme: appended data is written
+  *  immediately, before the host data is written. The state history
+  *  (psbplus.his) is written this way; its reader ignores entries that
+  *  do not match the state file.
+  */
+#ifndef STATEFILE_H_INCLUDED
+#define STATEFILE_H_INCLUDED
+
+#include <stddef.h>
+#include <phostpdk.h>
+
+/** State file opened for reading. */
+struct StateFile {
+    const Uns8* Data;           /**< File content. */
+    size_t      Size;           /**< File size. */
+    void*       Mapping;        /**< Internal: memory mapping, NULL if none. */
+    Uns8*       Buffer;         /**< Internal: allocated buffer, NULL if none. */
+};
+
+/** Open state file for reading.
+    @param [out] sf   State file
+    @param [in]  name File name (in game directory)
+    @return True if file was opened; must be closed using StateFile_Close(). False if file does not exist.
+    Exits the program if the file exists but cannot be read. */
+Boolean StateFile_Open(struct StateFile* sf, const char* name);
+
+/** Close state file.
+    @param [in,out] sf State file */
+void StateFile_Close(struct StateFile* sf);
+
+/** Prepare replacing a state file.
+    Writes the new content to a temporary file, and flushes it to disk.
+    The original file is not touched until StateFile_Commit().
+    Exits the program if the file cannot be written.
+    @param [in] name File name (in game directory)
+    @param [in] data New content
+    @param [in] size Size of new content */
+void StateFile_Stage(const char* name, const void* data, size_t size);
+
+/** Append to a state file.
+    The data is written and flushed to disk immediately.
+    Use only for files whose readers can cope with leftovers of an interrupted run.
+    Exits the program if the file cannot be written.
+    @param [in] name File name (in game directory)
+    @param [in] data Data to append
+    @param [in] size Size of data */
+void StateFile_Append(const char* name, const void* data, size_t size);
+
+/** Replace all state files prepared using StateFile_Stage().
+    @return True on success */
+Boolean StateFile_Commit(void);
+
+/** Discard all state files prepared using StateFile_Stage(). */
+void StateFile_Discard(void);
+
+/** Limit the number of bytes written (fault injection for testing).
+    After the given number of bytes has been written by StateFile_Stage() or StateFile_Append(),
+    further writes fail as if the disk were full.
+    @param [in] limit Number of bytes; negative for no limit (default) */
+void StateFile_SetWriteLimit(long limit);
+
+#endif
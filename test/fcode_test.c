@@ -0,0 +1,103 @@
+/**
+  *  \file test/fcode_test.c
+  *  \brief Starbase Reloaded - Friendly Code Test
+  *
+  *  Checks FCode_Decode() for every defined code and every numbered variant,
+  *  codes just past each limit, the wrong object type, and codes that must not
+  *  match anything (including an unset, all-NUL code).
+  */
+
+#include <stdio.h>
+#include "../fcode.h"
+
+/* Expected definitions. Kept separate from fcode.c on purpose. */
+static const struct {
+    const char*      Code;
+    int              Limit;
+    enum FCodeAction Action;
+    enum FCodeTarget Target;
+} EXPECTED[] = {
+    { "RMT", 0,         FC_ReceiveMoney,   FCT_Planet },
+    { "TM",  5,         FC_TransferMoney,  FCT_Planet },
+    { "LMF", 0,         FC_LayMines,       FCT_Planet },
+    { "LWF", 0,         FC_LayWebMines,    FCT_Planet },
+    { "SMF", 0,         FC_SweepMines,     FCT_Planet },
+    { "MSC", 0,         FC_ScoopMines,     FCT_Planet },
+    { "con", 0,         FC_SendConfig,     FCT_Planet },
+    { "UAP", 0,         FC_UnloadAll,      FCT_Ship   },
+    { "UE",  ENGINE_NR, FC_UnloadEngine,   FCT_Ship   },
+    { "UB",  BEAM_NR,   FC_UnloadBeam,     FCT_Ship   },
+    { "UT",  TORP_NR,   FC_UnloadLauncher, FCT_Ship   },
+    { "GE",  ENGINE_NR, FC_GetEngine,      FCT_Ship   },
+    { "GB",  BEAM_NR,   FC_GetBeam,        FCT_Ship   },
+    { "GT",  TORP_NR,   FC_GetLauncher,    FCT_Ship   },
+};
+
+static int gFailures;
+
+/* Decode a code and compare with expectation. */
+static void Check(const char fc[3], enum FCodeTarget target, enum FCodeAction action, Uns16 arg)
+{
+    Uns16 gotArg = 0xFFFF;
+    const enum FCodeAction got = FCode_Decode(fc, target, &gotArg);
+    if (got != action || gotArg != arg) {
+        printf("FAIL: \"%c%c%c\" (%02X %02X %02X), target %d: got action %d, arg %u; expected %d, %u\n",
+               fc[0] ? fc[0] : '.', fc[1] ? fc[1] : '.', fc[2] ? fc[2] : '.',
+               (Uns8) fc[0], (Uns8) fc[1], (Uns8) fc[2],
+               target, got, gotArg, action, arg);
+        ++gFailures;
+    }
+}
+
+static enum FCodeTarget OtherTarget(enum FCodeTarget target)
+{
+    return target == FCT_Planet ? FCT_Ship : FCT_Planet;
+}
+
+int main(void)
+{
+    for (size_t i = 0; i < sizeof(EXPECTED)/sizeof(EXPECTED[0]); ++i) {
+        const char* code = EXPECTED[i].Code;
+        const enum FCodeTarget target = EXPECTED[i].Target;
+        if (EXPECTED[i].Limit == 0) {
+            Check(code, target, EXPECTED[i].Action, 0);
+            Check(code, OtherTarget(target), FC_None, 0);
+        } else {
+            // Numbered variants, digit 0 meaning 10
+            for (int n = 1; n <= EXPECTED[i].Limit; ++n) {
+                const char fc[3] = { code[0], code[1], '0' + n % 10 };
+                Check(fc, target, EXPECTED[i].Action, n);
+                Check(fc, OtherTarget(target), FC_None, 0);
+            }
+
+            // One past the limit (e.g. TM6, and TM0 meaning 10); the digit 0 is only valid for a limit of 10
+            if (EXPECTED[i].Limit < 10) {
+                const char past[3] = { code[0], code[1], '0' + (EXPECTED[i].Limit + 1) % 10 };
+                Check(past, target, FC_None, 0);
+                const char zero[3] = { code[0], code[1], '0' };
+                Check(zero, target, FC_None, 0);
+            }
+
+            // Prefix alone, or followed by a non-digit
+            const char nul[3] = { code[0], code[1], '\0' };
+            Check(nul, target, FC_None, 0);
+            const char colon[3] = { code[0], code[1], '9' + 1 };
+            Check(colon, target, FC_None, 0);
+        }
+    }
+
+    // Unset friendly code
+    static const char ALL_NUL[3] = { 0, 0, 0 };
+    Check(ALL_NUL, FCT_Planet, FC_None, 0);
+    Check(ALL_NUL, FCT_Ship, FC_None, 0);
+
+    // Case-sensitive, and some unrelated codes
+    Check("rmt", FCT_Planet, FC_None, 0);
+    Check("CON", FCT_Planet, FC_None, 0);
+    Check("uap", FCT_Ship, FC_None, 0);
+    Check("   ", FCT_Ship, FC_None, 0);
+    Check("mkt", FCT_Planet, FC_None, 0);
+
+    printf("fcode_test: %s\n", gFailures == 0 ? "ok" : "FAILED");
+    return gFailures != 0;
+}
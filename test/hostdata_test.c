@@ -0,0 +1,42 @@
+/**
+  *  \file test/hostdata_test.c
+  *  \brief Starbase Reloaded - Host Data Idle Test
+  *
+  *  Every auxhost1/auxhost2 run defines its special friendly codes.
+  *  A run that does nothing else must not count as a modification,
+  *  and HostData_Save() must not write the host data.
+  *  No host data is loaded here, so a WriteHostData call would fail.
+  */
+
+#include <stdio.h>
+#include "../fcode.h"
+#include "../hostdata.h"
+
+static int gFailures;
+
+/* Check a condition; report failure. */
+static void Check(Boolean cond, const char* what)
+{
+    if (!cond) {
+        printf("FAIL: %s\n", what);
+        ++gFailures;
+    }
+}
+
+int main()
+{
+    // Define all codes, twice, like a run with all features enabled
+    for (int pass = 0; pass < 2; ++pass) {
+        for (int action = FC_ReceiveMoney; action <= FC_GetLauncher; ++action) {
+            FCode_DefineSpecial(action);
+        }
+    }
+
+    char what[100];
+    Check(HostData_Modified() == 0, "special friendly codes count as modification");
+    Check(HostData_Describe(what, sizeof(what))[0] == '\0', "description not empty");
+    Check(HostData_Save() == HD_Unchanged, "idle run writes host data");
+
+    printf("hostdata_test: %s\n", gFailures == 0 ? "ok" : "FAILED");
+    return gFailures != 0;
+}
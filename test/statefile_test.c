@@ -0,0 +1,143 @@
+/**
+  *  \file test/statefile_test.c
+  *  \brief Starbase Reloaded - State File Fault Injection Test
+  *
+  *  Simulates a full disk at many positions while writing a state file,
+  *  and a crash between StateFile_Stage() and StateFile_Commit().
+  *  Checks that the state file is never seen half-written,
+  *  and that the temporary file is either absent or complete.
+  *
+  *  Each failing write runs in a child process, because StateFile_Stage()
+  *  exits the program on failure.
+  */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "../statefile.h"
+
+#define OLD_SIZE 1000
+#define NEW_SIZE 1500
+
+static const char*const NAME = "psbplus.hst";
+static const char*const TEMP_NAME = "psbplus.hst.new";
+
+static char gDirectory[] = "/tmp/sbrtestXXXXXX";
+static Uns8 gOld[OLD_SIZE];
+static Uns8 gNew[NEW_SIZE];
+static int gFailures;
+
+/* Check a condition; report failure. */
+static void Check(Boolean cond, const char* what, long limit)
+{
+    if (!cond) {
+        printf("FAIL: %s (limit %ld)\n", what, limit);
+        ++gFailures;
+    }
+}
+
+/* Make path name of a file in the test directory. */
+static const char* MakePath(const char* name)
+{
+    static char path[200];
+    snprintf(path, sizeof(path), "%s/%s", gDirectory, name);
+    return path;
+}
+
+/* Check whether file exists. */
+static Boolean Exists(const char* name)
+{
+    return access(MakePath(name), F_OK) == 0;
+}
+
+/* Check whether file has exactly the given content. */
+static Boolean HasContent(const char* name, const Uns8* data, size_t size)
+{
+    FILE* f = fopen(MakePath(name), "rb");
+    if (f == NULL) {
+        return False;
+    }
+    static Uns8 buf[NEW_SIZE + OLD_SIZE + 1];
+    const size_t n = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+    return n == size && memcmp(buf, data, size) == 0;
+}
+
+/* Stage new content in a child process, using the given write limit.
+   If commit is false, the child terminates between stage and commit, simulating a crash. */
+static void RunChild(long limit, Boolean commit)
+{
+    fflush(stdout);
+    const pid_t pid = fork();
+    if (pid == 0) {
+        // Expected error messages are not interesting
+        freopen("/dev/null", "w", stderr);
+        StateFile_SetWriteLimit(limit);
+        StateFile_Stage(NAME, gNew, sizeof(gNew));
+        if (commit) {
+            StateFile_Commit();
+        }
+        _exit(0);
+    }
+    int status;
+    if (pid < 0 || waitpid(pid, &status, 0) != pid) {
+        Check(False, "fork", limit);
+    }
+}
+
+int main(void)
+{
+    if (mkdtemp(gDirectory) == NULL) {
+        perror("mkdtemp");
+        return 1;
+    }
+    gGameDirectory = gDirectory;
+    for (size_t i = 0; i < sizeof(gOld); ++i) {
+        gOld[i] = 'a' + i % 26;
+    }
+    for (size_t i = 0; i < sizeof(gNew); ++i) {
+        gNew[i] = (Uns8) (7*i);
+    }
+
+    // Initial content
+    StateFile_Stage(NAME, gOld, sizeof(gOld));
+    Check(StateFile_Commit(), "initial commit", -1);
+    Check(HasContent(NAME, gOld, sizeof(gOld)), "initial content", -1);
+
+    // Disk full at various positions: old file remains, no temporary file
+    for (long limit = 0; limit < NEW_SIZE; limit += (limit < 16 ? 1 : 61)) {
+        RunChild(limit, True);
+        Check(HasContent(NAME, gOld, sizeof(gOld)), "state file unchanged after failed write", limit);
+        Check(!Exists(TEMP_NAME), "no temporary file after failed write", limit);
+    }
+    RunChild(NEW_SIZE-1, True);
+    Check(HasContent(NAME, gOld, sizeof(gOld)), "state file unchanged after failed write", NEW_SIZE-1);
+    Check(!Exists(TEMP_NAME), "no temporary file after failed write", NEW_SIZE-1);
+
+    // Crash before commit: old file remains, temporary file is complete
+    RunChild(-1, False);
+    Check(HasContent(NAME, gOld, sizeof(gOld)), "state file unchanged after crash", -1);
+    Check(!Exists(TEMP_NAME) || HasContent(TEMP_NAME, gNew, sizeof(gNew)), "temporary file complete after crash", -1);
+
+    // Host data could not be written: discard
+    StateFile_Stage(NAME, gNew, sizeof(gNew));
+    StateFile_Discard();
+    Check(HasContent(NAME, gOld, sizeof(gOld)), "state file unchanged after discard", -1);
+    Check(!Exists(TEMP_NAME), "no temporary file after discard", -1);
+
+    // Success
+    StateFile_Stage(NAME, gNew, sizeof(gNew));
+    Check(StateFile_Commit(), "commit", -1);
+    Check(HasContent(NAME, gNew, sizeof(gNew)), "new content after commit", -1);
+    Check(!Exists(TEMP_NAME), "no temporary file after commit", -1);
+
+    remove(MakePath(NAME));
+    remove(MakePath(TEMP_NAME));
+    rmdir(gDirectory);
+
+    printf("statefile_test: %s\n", gFailures == 0 ? "ok" : "FAILED");
+    return gFailures != 0;
+}
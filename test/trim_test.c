@@ -0,0 +1,171 @@
+/**
+  *  \file test/trim_test.c
+  *  \brief Starbase Reloaded - Cargo Trimming Equivalence Test
+  *
+  *  Compares Trim_Components() and Trim_RegularCargo() against the original
+  *  implementation, which dropped one component resp. one share at a time,
+  *  on random ships. Both must produce exactly the same result.
+  */
+
+#include <stdio.h>
+#include <string.h>
+#include "../trim.h"
+#include "../util.h"
+
+#define NUM_CASES 200000
+
+static struct Profiles gProfiles;
+static Uns32 gSeed = 1;
+
+/* Pseudo-random number in [0, n). Deterministic, so failures can be reproduced. */
+static Uns32 Random(Uns32 n)
+{
+    gSeed = gSeed * 1103515245 + 12345;
+    return (gSeed >> 8) % n;
+}
+
+/*
+ *  Reference implementation
+ */
+
+/* Remove one component of the given type. Returns its mass; 0 if there was none. */
+static Uns16 RemoveComponent(struct TransportShip* sh, int first, int count)
+{
+    for (int slot = first; slot < first + count; ++slot) {
+        if (sh->Slots[slot] > 0) {
+            --sh->Slots[slot];
+            return gProfiles.ComponentMass[slot];
+        }
+    }
+    return 0;
+}
+
+static Uns16 OldTrimComponents(struct TransportShip* sh, Uns32* pMass, Uns32 maxMass)
+{
+    static const int TYPES[][2] = {
+        { TRANSPORT_BEAM_SLOT,     BEAM_NR },
+        { TRANSPORT_LAUNCHER_SLOT, TORP_NR },
+        { TRANSPORT_ENGINE_SLOT,   ENGINE_NR },
+    };
+    Uns16 droppedComponents = 0;
+    while (*pMass > maxMass) {
+        Boolean ok = False;
+        for (int t = 0; t < 3; ++t) {
+            Uns16 removedMass = RemoveComponent(sh, TYPES[t][0], TYPES[t][1]);
+            if (removedMass != 0) {
+                ++droppedComponents;
+                *pMass -= removedMass;
+                if (*pMass <= maxMass) {
+                    return droppedComponents;
+                }
+                ok = True;
+            }
+        }
+        if (!ok) {
+            break;
+        }
+    }
+    return droppedComponents;
+}
+
+static Boolean RemoveCargo(Uns16* have, Uns16* acc, Uns16 limit)
+{
+    Uns16 drop = MIN(*have, MIN(*acc, limit));
+    if (drop != 0) {
+        *have -= drop;
+        *acc -= drop;
+        return True;
+    } else {
+        return False;
+    }
+}
+
+static void OldTrimRegularCargo(Uns16 cargo[SHIP_CARGO_NR], Uns16 toDrop)
+{
+    while (toDrop > 0) {
+        Uns16 toDropNow = MAX(toDrop / 6, 1);
+        Boolean ok = False;
+        for (int i = 0; i < SHIP_CARGO_NR; ++i) {
+            ok |= RemoveCargo(&cargo[i], &toDrop, toDropNow);
+        }
+        if (!ok) {
+            break;
+        }
+    }
+}
+
+/*
+ *  Test driver
+ */
+
+/* Make random component load. Most slots are empty; some ships carry very many components. */
+static Uns32 MakeShip(struct TransportShip* sh)
+{
+    const Uns32 density = 1 + Random(8);
+    const Uns32 maxAmount = (Random(4) == 0 ? 2000 : 20);
+    Uns32 mass = 0;
+    for (int i = 0; i < TRANSPORT_SLOT_NR; ++i) {
+        sh->Slots[i] = (Random(density + 1) == 0 ? 1 + Random(maxAmount) : 0);
+        mass += (Uns32) sh->Slots[i] * gProfiles.ComponentMass[i];
+    }
+    return mass;
+}
+
+static Boolean TestComponents(int n)
+{
+    struct TransportShip a, b;
+    const Uns32 mass = MakeShip(&a);
+    const Uns32 maxMass = (mass == 0 ? 0 : Random(mass + mass/4 + 1));
+    b = a;
+
+    Uns32 massA = mass, massB = mass;
+    const Uns16 countA = OldTrimComponents(&a, &massA, maxMass);
+    const Uns16 countB = Trim_Components(&b, &gProfiles, &massB, maxMass);
+    if (countA != countB || massA != massB || memcmp(&a, &b, sizeof(a)) != 0) {
+        printf("FAIL: Trim_Components, case %d: mass %lu, max %lu: dropped %u/%u, mass %lu/%lu\n",
+               n, (unsigned long) mass, (unsigned long) maxMass, countA, countB, (unsigned long) massA, (unsigned long) massB);
+        return False;
+    }
+    return True;
+}
+
+static Boolean TestRegularCargo(int n)
+{
+    Uns16 a[SHIP_CARGO_NR], b[SHIP_CARGO_NR];
+    Uns32 total = 0;
+    const Uns32 maxAmount = (Random(4) == 0 ? 10000 : 300);
+    for (int i = 0; i < SHIP_CARGO_NR; ++i) {
+        a[i] = b[i] = (Random(3) == 0 ? 0 : Random(maxAmount));
+        total += a[i];
+    }
+    const Uns16 toDrop = Random(MIN(total + total/4 + 2, 0x10000));
+    OldTrimRegularCargo(a, toDrop);
+    Trim_RegularCargo(b, toDrop);
+    if (memcmp(a, b, sizeof(a)) != 0) {
+        printf("FAIL: Trim_RegularCargo, case %d: drop %u\n", n, toDrop);
+        return False;
+    }
+    return True;
+}
+
+int main(void)
+{
+    int failures = 0;
+    for (int n = 0; n < NUM_CASES && failures < 10; ++n) {
+        // New component masses every now and then
+        if (n % 1000 == 0) {
+            for (int i = 0; i <= TRANSPORT_SLOT_NR; ++i) {
+                gProfiles.ComponentMass[i] = 1 + Random(n % 3000 == 0 ? 2 : 200);
+            }
+        }
+        if (!TestComponents(n)) {
+            ++failures;
+        }
+        if (!TestRegularCargo(n)) {
+            ++failures;
+        }
+    }
+
+    printf("trim_test: %s\n", failures == 0 ? "ok" : "FAILED");
+    return failures != 0;
+}
@@ -0,0 +1,155 @@
+/**
+  *  \file test/utilfile_bench.c
+  *  \brief Starbase Reloaded - util.tmp Reader Benchmark
+  *
+  *  Compares the memory-mapped util.tmp reader (utilfile.c) against the
+  *  original DOSRead16/fseek loop, scanning a synthetic util.tmp for
+  *  "ship built" records. Both must find the same records.
+  *
+  *  Usage: utilfile_bench [megabytes]
+  */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../utilfile.h"
+#include "../utildata.h"
+
+#define ROUNDS 5
+
+static char gDirectory[] = "/tmp/sbrbenchXXXXXX";
+
+/* Write little-endian 16-bit value. */
+static void Put16(FILE* f, Uns16 value)
+{
+    fputc(value & 0xFF, f);
+    fputc(value >> 8, f);
+}
+
+/* Make synthetic util.tmp: a mix of record types and sizes like a real turn. Returns number of ship-built records. */
+static Uns32 MakeFile(const char* path, Uns32 megabytes)
+{
+    FILE* f = fopen(path, "wb");
+    if (f == NULL) {
+        perror(path);
+        exit(1);
+    }
+    Uns32 seed = 1;
+    Uns32 numBuilt = 0;
+    long size = 0;
+    while (size < (long) megabytes << 20) {
+        seed = seed * 1103515245 + 12345;
+        const Uns16 type = ((seed >> 8) % 50 == 0 ? UTIL_SHIP_BUILT : (seed >> 16) % 60);
+        const Uns16 recordSize = (type == UTIL_SHIP_BUILT ? 4 : 2 * ((seed >> 12) % 40));
+        Put16(f, 1 + (seed >> 20) % RACE_NR);
+        Put16(f, type);
+        Put16(f, recordSize);
+        for (Uns16 i = 0; i < recordSize; ++i) {
+            fputc(i, f);
+        }
+        if (type == UTIL_SHIP_BUILT) {
+            ++numBuilt;
+        }
+        size += 6 + recordSize;
+    }
+    fclose(f);
+    return numBuilt;
+}
+
+/* Original implementation: read headers with DOSRead16, skip bodies with fseek. */
+static Uns32 ScanOld(void)
+{
+    FILE* fp = OpenInputFile("util.tmp", GAME_DIR_ONLY | NO_MISSING_ERROR);
+    if (fp == NULL) {
+        return 0;
+    }
+    enum { PlayerSlot, TypeSlot, SizeSlot, HEADER_SIZE };
+    Uns16 header[HEADER_SIZE];
+    enum { ShipSlot, BaseSlot, BODY_SIZE };
+    Uns16 body[BODY_SIZE];
+    Uns32 found = 0;
+    while (DOSRead16(header, HEADER_SIZE, fp)) {
+        if (header[TypeSlot] == UTIL_SHIP_BUILT && header[SizeSlot] >= sizeof(body)) {
+            if (!DOSRead16(body, BODY_SIZE, fp)) {
+                break;
+            }
+            found += (body[ShipSlot] != 0);
+            header[SizeSlot] -= sizeof(body);
+        }
+        fseek(fp, header[SizeSlot], SEEK_CUR);
+    }
+    fclose(fp);
+    return found;
+}
+
+/* UtilFile_Handler: count ship-built records. */
+static void CountShipBuilt(void* context, const struct UtilRecord* rec)
+{
+    struct UtilShipBuilt sb;
+    if (UtilRecord_GetShipBuilt(rec, &sb) && sb.ShipId != 0) {
+        ++*(Uns32*) context;
+    }
+}
+
+/* New implementation. */
+static Uns32 ScanNew(void)
+{
+    Uns32 found = 0;
+    struct UtilFileScan sc;
+    UtilFileScan_Init(&sc);
+    UtilFileScan_Add(&sc, UTIL_SHIP_BUILT, CountShipBuilt, &found);
+
+    struct UtilFile uf;
+    if (UtilFile_Open(&uf, "util.tmp")) {
+        UtilFileScan_Run(&sc, &uf);
+        UtilFile_Close(&uf);
+    }
+    return found;
+}
+
+/* Run a scan ROUNDS times. Returns best time in seconds. */
+static double Measure(Uns32 (*scan)(void), Uns32* found)
+{
+    double best = 0;
+    for (int i = 0; i < ROUNDS; ++i) {
+        const clock_t start = clock();
+        *found = scan();
+        const double t = (double) (clock() - start) / CLOCKS_PER_SEC;
+        if (i == 0 || t < best) {
+            best = t;
+        }
+    }
+    return best;
+}
+
+int main(int argc, char** argv)
+{
+    const Uns32 megabytes = (argc > 1 ? (Uns32) atoi(argv[1]) : 20);
+    if (mkdtemp(gDirectory) == NULL) {
+        perror("mkdtemp");
+        return 1;
+    }
+    gGameDirectory = gDirectory;
+
+    char path[100];
+    snprintf(path, sizeof(path), "%s/util.tmp", gDirectory);
+    const Uns32 expected = MakeFile(path, megabytes);
+
+    Uns32 foundOld, foundNew;
+    const double timeOld = Measure(ScanOld, &foundOld);
+    const double timeNew = Measure(ScanNew, &foundNew);
+
+    remove(path);
+    rmdir(gDirectory);
+
+    printf("util.tmp: %lu MB, %lu ship-built records\n", (unsigned long) megabytes, (unsigned long) expected);
+    printf("DOSRead16/fseek: %8.3f s (%lu found)\n", timeOld, (unsigned long) foundOld);
+    printf("utilfile:        %8.3f s (%lu found)\n", timeNew, (unsigned long) foundNew);
+    if (timeNew > 0) {
+        printf("speedup:         %8.1fx\n", timeOld / timeNew);
+    }
+    return (foundOld != expected || foundNew != expected);
+}
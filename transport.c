@@ -3,14 +3,21 @@
   *  \brief Starbase Reloaded - Component Transport
   */
 
+#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 #include "transport.h"
 #include "config.h"
+#include "fcode.h"
 #include "util.h"
+#include "hostdata.h"
 #include "message.h"
+#include "snapshot.h"
 #include "utildata.h"
 #include "language.h"
+#include "statefile.h"
+#include "trim.h"
+#include "utilfile.h"
 
 /*
  *  Definitions
@@ -30,7 +37,7 @@ static const Boolean ACCEPT_MULTIPLE_TYPES = True;
 static const char*const STATE_FILE_NAME = "psbplus.hst";
 
 /* Prefix for ship names. */
-static const char*const NAME_PREFIX = "ST: ";
+static const char*const NAME_PREFIX = TRANSPORT_NAME_PREFIX;
 
 /* Maximum number of items in storage.
    See MAX_BASE_TORPS for reasoning. */
@@ -41,185 +48,835 @@ static const Uns16 MAX_BASE_COMPONENTS = 10000;
  *  Generic Utilities
  */
 
-static Uns16 BaseComponents(Uns16 planetId, BaseTech_Def type, Uns16 slot)
+static const char* ComponentTypeName(BaseTech_Def type)
 {
-    Uns16 result = 0;
     switch (type) {
-     case ENGINE_TECH: result = (slot > 0 && slot <= ENGINE_NR ? BaseEngines(planetId, slot) : 0); break;
-     case BEAM_TECH:   result = (slot > 0 && slot <= BEAM_NR   ? BaseBeams(planetId, slot)   : 0); break;
-     case TORP_TECH:   result = (slot > 0 && slot <= TORP_NR   ? BaseTubes(planetId, slot)   : 0); break;
-     default:;
+     case ENGINE_TECH: return "engine";
+     case BEAM_TECH:   return "beam";
+     case TORP_TECH:   return "launcher";
+     default:          return "?";
+    }
+}
+
+static Uns16 ComponentMass(const struct Profiles* p, BaseTech_Def type, Uns16 slot)
+{
+    return p->ComponentMass[TransportShip_SlotIndex(type, slot)];
+}
+
+/*
+ *  TransportState class
+ */
+
+static void TransportState_Init(struct TransportState* st)
+{
+    memset(st, 0, sizeof(*st));
+}
+
+/* Update carrier bit after a ship's cargo has been modified. */
+static void TransportState_Sync(struct TransportState* st, Uns16 shipId)
+{
+    if (shipId > 0 && shipId <= SHIP_NR) {
+        const Uns16 bit = shipId-1;
+        if (TransportShip_HasComponents(TransportState_Find(st, shipId))) {
+            st->Carriers[bit / 32] |= 1UL << (bit % 32);
+        } else {
+            st->Carriers[bit / 32] &= ~(1UL << (bit % 32));
+        }
+    }
+}
+
+/* Access trim fingerprint of a ship. Returns NULL if ship has no record. */
+static Uns32* TransportState_TrimFingerprint(struct TransportState* st, Uns16 shipId)
+{
+    if (shipId > 0 && shipId <= SHIP_NR && st->Index[shipId-1] != 0) {
+        return &st->TrimFingerprints[st->Index[shipId-1] - 1];
+    } else {
+        return NULL;
+    }
+}
+
+/* Access identity of a ship. Returns NULL if ship has no record. */
+static struct TransportIdentity* TransportState_Identity(struct TransportState* st, Uns16 shipId)
+{
+    if (shipId > 0 && shipId <= SHIP_NR && st->Index[shipId-1] != 0) {
+        return &st->Identities[st->Index[shipId-1] - 1];
+    } else {
+        return NULL;
+    }
+}
+
+/*
+ *  State file format
+ *
+ *  Version 0 (pstarbase):
+ *      Uns16   version (0)
+ *      for each ship: Uns16 beams[BEAM_NR], launchers[TORP_NR], engines[ENGINE_NR]
+ *
+ *  Version 1:
+ *      Uns16   version (1)
+ *      Uns16   number of ships in game (SHIP_NR)
+ *      stamp   state identification (see below)
+ *      Uns16   number of records
+ *      for each ship carrying components:
+ *          record
+ *      optional:
+ *          Uns16   number of trim fingerprints
+ *          for each ship that has one:
+ *              Uns16   ship Id
+ *              Uns32   fingerprint (see TrimFingerprint())
+ *      optional:
+ *          Uns16   number of identities
+ *          for each ship that has one:
+ *              Uns16   ship Id
+ *              Uns16   hull
+ *              Uns16   owner
+ *              Uns32   name hash
+ *      optional:
+ *          Uns16   number of message digests
+ *          for each ship that has one:
+ *              Uns16   ship Id
+ *              Uns32   digest of last cargo report (0 if none)
+ *              Uns32   digest of last failure message (0 if none)
+ *      Uns32   CRC-32C of everything before
+ *
+ *  stamp:
+ *      Uns16   turn number
+ *      Uns16   phase (enum TransportPhase)
+ *      Uns32   generation
+ *
+ *  record:
+ *      Uns16   ship Id
+ *      Uns32   slot mask; bit N set if slot N is nonzero (slots numbered as in version 0)
+ *      varint  count, for each bit set in the mask
+ *
+ *  All values little-endian. Varints store 7 bits per byte, low bits first,
+ *  with bit 7 set on all but the last byte.
+ *
+ *  History file:
+ *      for each run that saved a state, oldest first:
+ *          Uns32   size of body
+ *          body:
+ *              stamp   state produced by this run
+ *              stamp   state this run started from
+ *              Uns16   number of records
+ *              for each ship modified by this run:
+ *                  record, containing the ship's content before the run
+ *          Uns32   CRC-32C of body
+ *          Uns32   size of body (again, to allow reading backwards)
+ *
+ *  A history entry therefore turns the state it produced back into the
+ *  state it started from. Entries are matched by generation, which is
+ *  unique for every saved state; entries of runs whose state was never
+ *  committed (crash, rerun) do not match anything and are skipped.
+ */
+
+static const Uns16 STATE_VERSION = 1;
+static const size_t STATE_HEADER_SIZE = 14;
+static const size_t STATE_TRAILER_SIZE = 4;
+
+static const char*const HISTORY_FILE_NAME = "psbplus.his";
+static const size_t HISTORY_HEADER_SIZE = 18;
+static const size_t HISTORY_OVERHEAD = 12;
+
+/* Maximum size of a record: Id, mask, three bytes per varint (Uns16). */
+static const size_t MAX_RECORD_SIZE = 2 + 4 + 3*TRANSPORT_SLOT_NR;
+
+/* Order of stamps, for comparison. */
+static Uns32 TransportStamp_Order(const struct TransportStamp* stamp)
+{
+    return ((Uns32) stamp->Turn << 16) | stamp->Phase;
+}
+
+/* Output buffer */
+struct Writer {
+    Uns8*  Data;
+    size_t Size;
+};
+
+static void Writer_Init(struct Writer* w, size_t maxSize)
+{
+    w->Data = malloc(maxSize);
+    w->Size = 0;
+    if (w->Data == NULL) {
+        ErrorExit("Out of memory");
+    }
+}
+
+static void Writer_Put8(struct Writer* w, Uns8 value)
+{
+    w->Data[w->Size++] = value;
+}
+
+static void Writer_Put16(struct Writer* w, Uns16 value)
+{
+    Writer_Put8(w, value & 0xFF);
+    Writer_Put8(w, value >> 8);
+}
+
+static void Writer_Put32(struct Writer* w, Uns32 value)
+{
+    Writer_Put16(w, value & 0xFFFF);
+    Writer_Put16(w, value >> 16);
+}
+
+static void Writer_PutVarint(struct Writer* w, Uns32 value)
+{
+    while (value >= 0x80) {
+        Writer_Put8(w, (value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    Writer_Put8(w, value);
+}
+
+static void Writer_PutStamp(struct Writer* w, const struct TransportStamp* stamp)
+{
+    Writer_Put16(w, stamp->Turn);
+    Writer_Put16(w, stamp->Phase);
+    Writer_Put32(w, stamp->Generation);
+}
+
+static void Writer_PutRecord(struct Writer* w, Uns16 shipId, const struct TransportShip* info)
+{
+    Uns32 mask = 0;
+    for (int slot = 0; slot < TRANSPORT_SLOT_NR; ++slot) {
+        if (info->Slots[slot] != 0) {
+            mask |= 1UL << slot;
+        }
     }
-    // Info("##  BaseComponents(%d,%d,%d) => %d", planetId, type, slot, result);
+    Writer_Put16(w, shipId);
+    Writer_Put32(w, mask);
+    for (int slot = 0; slot < TRANSPORT_SLOT_NR; ++slot) {
+        if (mask & (1UL << slot)) {
+            Writer_PutVarint(w, info->Slots[slot]);
+        }
+    }
+}
+
+/* Input buffer. Reading past the end sets Error. */
+struct Reader {
+    const Uns8* Data;
+    size_t      Size;
+    size_t      Pos;
+    Boolean     Error;
+};
+
+static Uns8 Reader_Get8(struct Reader* r)
+{
+    if (r->Pos >= r->Size) {
+        r->Error = True;
+        return 0;
+    }
+    return r->Data[r->Pos++];
+}
+
+static Uns16 Reader_Get16(struct Reader* r)
+{
+    Uns16 lo = Reader_Get8(r);
+    Uns16 hi = Reader_Get8(r);
+    return lo | (hi << 8);
+}
+
+static Uns32 Reader_Get32(struct Reader* r)
+{
+    Uns32 lo = Reader_Get16(r);
+    Uns32 hi = Reader_Get16(r);
+    return lo | (hi << 16);
+}
+
+static Uns32 Reader_GetVarint(struct Reader* r)
+{
+    Uns32 result = 0;
+    int shift = 0;
+    Uns8 byte;
+    do {
+        byte = Reader_Get8(r);
+        if (shift > 28) {
+            r->Error = True;
+            return 0;
+        }
+        result |= (Uns32) (byte & 0x7F) << shift;
+        shift += 7;
+    } while ((byte & 0x80) != 0 && !r->Error);
     return result;
 }
 
-static void PutBaseComponents(Uns16 planetId, BaseTech_Def type, Uns16 slot, Uns16 amount)
+static void Reader_GetStamp(struct Reader* r, struct TransportStamp* stamp)
 {
-    // Info("##  PutBaseComponents(%d,%d,%d) <= %d", planetId, type, slot, amount);
-    switch (type) {
-     case ENGINE_TECH:
-        if (slot > 0 && slot <= ENGINE_NR) {
-            PutBaseEngines(planetId, slot, amount);
+    stamp->Turn = Reader_Get16(r);
+    stamp->Phase = Reader_Get16(r);
+    stamp->Generation = Reader_Get32(r);
+}
+
+/* Read a record. Returns ship Id; 0 if the ship does not exist in this game (Host999 > Host500). */
+static Uns16 Reader_GetRecord(struct Reader* r, struct TransportShip* info)
+{
+    const Uns16 shipId = Reader_Get16(r);
+    const Uns32 mask = Reader_Get32(r);
+    memset(info, 0, sizeof(*info));
+    for (int slot = 0; slot < TRANSPORT_SLOT_NR; ++slot) {
+        if (mask & (1UL << slot)) {
+            const Uns32 value = Reader_GetVarint(r);
+            info->Slots[slot] = MIN(value, 0xFFFF);
         }
-        break;
-     case BEAM_TECH:
-        if (slot > 0 && slot <= BEAM_NR) {
-            PutBaseBeams(planetId, slot, amount);
+    }
+    return (r->Error || shipId > SHIP_NR) ? 0 : shipId;
+}
+
+/* Parse version 0 content (after version number).
+   Read as much as we get to survive a possible Host500 > Host999 transition. */
+static void ParseVersion0(struct TransportState* st, struct Reader* r)
+{
+    for (Uns16 shipId = 1; shipId <= SHIP_NR && r->Size - r->Pos >= 2*TRANSPORT_SLOT_NR; ++shipId) {
+        struct TransportShip info;
+        for (int i = 0; i < TRANSPORT_SLOT_NR; ++i) {
+            info.Slots[i] = Reader_Get16(r);
         }
-        break;
-     case TORP_TECH:
-        if (slot > 0 && slot <= TORP_NR) {
-            PutBaseTubes(planetId, slot, amount);
+        if (TransportShip_HasComponents(&info)) {
+            *TransportState_Ship(st, shipId) = info;
+            TransportState_Sync(st, shipId);
         }
-        break;
-     default:;
     }
 }
 
-static Uns16 BaseReservedComponents(Uns16 planetId, BaseTech_Def type, Uns16 slot)
+/* Parse version 1 content (after version number). Returns false if file is invalid. */
+static Boolean ParseVersion1(struct TransportState* st, struct Reader* r)
 {
-    Uns16 result = 0;
-    BuildOrder_Struct order;
-    if (BaseBuildOrder(planetId, &order)) {
-        switch (type) {
-         case ENGINE_TECH:
-            // FIXME: MapTruehullByPlayerRace?
-            if (slot == order.mEngineType) {
-                result = HullEngineNumber(EffTrueHull(BaseOwner(planetId), order.mHull));
+    // Verify checksum
+    if (r->Size < STATE_HEADER_SIZE + STATE_TRAILER_SIZE) {
+        return False;
+    }
+    struct Reader trailer = { r->Data, r->Size, r->Size - STATE_TRAILER_SIZE, False };
+    if (Reader_Get32(&trailer) != Crc32c(0, r->Data, r->Size - STATE_TRAILER_SIZE)) {
+        return False;
+    }
+    r->Size -= STATE_TRAILER_SIZE;
+
+    // Header
+    /* const Uns16 numShips = */ Reader_Get16(r);
+    Reader_GetStamp(r, &st->Stamp);
+    const Uns16 numRecords = Reader_Get16(r);
+
+    // Records
+    for (Uns16 i = 0; i < numRecords && !r->Error; ++i) {
+        struct TransportShip info;
+        const Uns16 shipId = Reader_GetRecord(r, &info);
+        if (shipId != 0 && TransportShip_HasComponents(&info)) {
+            *TransportState_Ship(st, shipId) = info;
+            TransportState_Sync(st, shipId);
+        }
+    }
+
+    // Trim fingerprints
+    if (!r->Error && r->Pos < r->Size) {
+        const Uns16 numFingerprints = Reader_Get16(r);
+        for (Uns16 i = 0; i < numFingerprints && !r->Error; ++i) {
+            const Uns16 shipId = Reader_Get16(r);
+            const Uns32 fingerprint = Reader_Get32(r);
+            Uns32* p = TransportState_TrimFingerprint(st, shipId);
+            if (p != NULL) {
+                *p = fingerprint;
             }
-            break;
-         case BEAM_TECH:
-            if (slot == order.mBeamType) {
-                result = order.mNumBeams;
+        }
+    }
+
+    // Identities
+    if (!r->Error && r->Pos < r->Size) {
+        const Uns16 numIdentities = Reader_Get16(r);
+        for (Uns16 i = 0; i < numIdentities && !r->Error; ++i) {
+            const Uns16 shipId = Reader_Get16(r);
+            struct TransportIdentity id;
+            id.Hull = Reader_Get16(r);
+            id.Owner = Reader_Get16(r);
+            id.NameHash = Reader_Get32(r);
+            struct TransportIdentity* p = TransportState_Identity(st, shipId);
+            if (p != NULL) {
+                *p = id;
             }
-            break;
-         case TORP_TECH:
-            if (slot == order.mTubeType) {
-                result = order.mNumTubes;
+        }
+    }
+
+    // Message digests
+    if (!r->Error && r->Pos < r->Size) {
+        const Uns16 numDigests = Reader_Get16(r);
+        for (Uns16 i = 0; i < numDigests && !r->Error; ++i) {
+            const Uns16 shipId = Reader_Get16(r);
+            const Uns32 report = Reader_Get32(r);
+            const Uns32 failure = Reader_Get32(r);
+            if (shipId > 0 && shipId <= SHIP_NR) {
+                st->ReportDigests[shipId-1] = report;
+                st->FailureDigests[shipId-1] = failure;
             }
-            break;
-         default:;
         }
     }
-    // Info("##  BaseComponents(%d,%d,%d) => %d", planetId, type, slot, result);
-    return result;
+    return !r->Error && r->Pos == r->Size;
 }
 
-static const char* ComponentTypeName(BaseTech_Def type)
+/*
+ *  History
+ */
+
+/* History entry. */
+struct HistoryEntry {
+    size_t Start;                   /* Position of first byte (leading size field). */
+    struct TransportStamp Stamp;    /* State produced by this entry's run. */
+    struct TransportStamp Previous; /* State this entry's run started from. */
+    struct Reader Records;          /* Reader for record count and records. */
+};
+
+/* Parse history entry whose body starts at the given position.
+   Returns false if the entry is damaged. */
+static Boolean HistoryEntry_Parse(struct HistoryEntry* e, const struct StateFile* sf, size_t bodyPos, Uns32 bodySize)
 {
-    switch (type) {
-     case ENGINE_TECH: return "engine";
-     case BEAM_TECH:   return "beam";
-     case TORP_TECH:   return "launcher";
-     default:          return "?";
+    if (bodyPos < 4 || bodySize < HISTORY_HEADER_SIZE || bodyPos > sf->Size || sf->Size - bodyPos < (size_t) bodySize + 8) {
+        return False;
     }
+
+    struct Reader r = { sf->Data, sf->Size, bodyPos - 4, False };
+    const Uns32 leadingSize = Reader_Get32(&r);
+    r.Pos = bodyPos + bodySize;
+    const Uns32 crc = Reader_Get32(&r);
+    const Uns32 trailingSize = Reader_Get32(&r);
+    if (leadingSize != bodySize || trailingSize != bodySize || crc != Crc32c(0, sf->Data + bodyPos, bodySize)) {
+        return False;
+    }
+
+    e->Start = bodyPos - 4;
+    r.Size = bodyPos + bodySize;
+    r.Pos = bodyPos;
+    Reader_GetStamp(&r, &e->Stamp);
+    Reader_GetStamp(&r, &e->Previous);
+    e->Records = r;
+    return True;
 }
 
-static Uns16 ComponentMass(const struct Config* c, BaseTech_Def type, Uns16 slot)
+/* Parse history entry ending at the given position. */
+static Boolean HistoryEntry_ParseBefore(struct HistoryEntry* e, const struct StateFile* sf, size_t end)
 {
-    // Components weigh at least CargoSpacePerComp, but can weigh more if configured in the ship list.
-    // This function must not return 0.
-    Uns16 weight = 1;
-    switch (type) {
-     case BEAM_TECH:
-        if (slot > 0 && slot <= BEAM_NR) {
-            weight = BeamMass(slot);
+    if (end < HISTORY_OVERHEAD || end > sf->Size) {
+        return False;
+    }
+    struct Reader r = { sf->Data, end, end - 4, False };
+    const Uns32 bodySize = Reader_Get32(&r);
+    if (bodySize > end - HISTORY_OVERHEAD) {
+        return False;
+    }
+    return HistoryEntry_Parse(e, sf, end - 8 - bodySize, bodySize);
+}
+
+/* Parse history entry starting at the given position. */
+static Boolean HistoryEntry_ParseAt(struct HistoryEntry* e, const struct StateFile* sf, size_t start)
+{
+    if (start > sf->Size || sf->Size - start < HISTORY_OVERHEAD) {
+        return False;
+    }
+    struct Reader r = { sf->Data, sf->Size, start, False };
+    const Uns32 bodySize = Reader_Get32(&r);
+    return HistoryEntry_Parse(e, sf, start + 4, bodySize);
+}
+
+/* Apply history entry: restore all ships it recorded. */
+static Boolean HistoryEntry_Apply(const struct HistoryEntry* e, struct TransportState* st)
+{
+    struct Reader r = e->Records;
+    const Uns16 numRecords = Reader_Get16(&r);
+    for (Uns16 i = 0; i < numRecords && !r.Error; ++i) {
+        struct TransportShip info;
+        const Uns16 shipId = Reader_GetRecord(&r, &info);
+        if (shipId != 0 && (TransportShip_HasComponents(&info) || TransportState_Find(st, shipId) != 0)) {
+            *TransportState_Ship(st, shipId) = info;
+            TransportState_Sync(st, shipId);
         }
-        break;
-     case TORP_TECH:
-        if (slot > 0 && slot <= TORP_NR) {
-            weight = TorpTubeMass(slot);
+    }
+    st->Stamp = e->Previous;
+    return !r.Error;
+}
+
+/* Roll back state to what it was before the given phase of the current turn.
+   This is needed when a turn is re-run after restoring the host data from backup:
+   the state file then already contains the result of the previous attempt.
+   If the history does not reach back far enough (or is disabled), the state is used as loaded. */
+static void RollBack(struct TransportState* st, enum TransportPhase phase)
+{
+    const struct TransportStamp target = { Turn(), phase, 0 };
+    if (TransportStamp_Order(&st->Stamp) < TransportStamp_Order(&target)) {
+        return;
+    }
+
+    Info("    State file is from turn %d, phase %d; rolling back for re-run...", st->Stamp.Turn, st->Stamp.Phase);
+
+    struct StateFile sf;
+    if (!StateFile_Open(&sf, HISTORY_FILE_NAME)) {
+        Warning("No state history (%s); continuing with state file (%s) as is.", HISTORY_FILE_NAME, STATE_FILE_NAME);
+        return;
+    }
+
+    // Check that the history reaches the target, so we do not stop half-way.
+    struct TransportStamp stamp = st->Stamp;
+    size_t end = sf.Size;
+    struct HistoryEntry e;
+    while (TransportStamp_Order(&stamp) >= TransportStamp_Order(&target)
+           && HistoryEntry_ParseBefore(&e, &sf, end))
+    {
+        if (e.Stamp.Generation == stamp.Generation) {
+            stamp = e.Previous;
+        }
+        end = e.Start;
+    }
+    if (TransportStamp_Order(&stamp) >= TransportStamp_Order(&target)) {
+        StateFile_Close(&sf);
+        Warning("State history (%s) does not reach back to turn %d; continuing with state file (%s) as is.", HISTORY_FILE_NAME, target.Turn, STATE_FILE_NAME);
+        return;
+    }
+
+    // Apply
+    int count = 0;
+    end = sf.Size;
+    while (TransportStamp_Order(&st->Stamp) >= TransportStamp_Order(&target)
+           && HistoryEntry_ParseBefore(&e, &sf, end))
+    {
+        if (e.Stamp.Generation == st->Stamp.Generation) {
+            if (!HistoryEntry_Apply(&e, st)) {
+                // Do not continue; the state has been rolled back partially.
+                StateFile_Close(&sf);
+                ErrorExit("State history (%s) is corrupt", HISTORY_FILE_NAME);
+            }
+            ++count;
         }
-        break;
-     default:;
+        end = e.Start;
     }
+    StateFile_Close(&sf);
+    Info("    Rolled back %d run(s).", count);
 
-    return MAX(MAX(c->CargoSpacePerComp, weight), 1);
+    // Messages of the rolled-back runs have been discarded with the host data; send them again.
+    memset(st->ReportDigests, 0, sizeof(st->ReportDigests));
+    memset(st->FailureDigests, 0, sizeof(st->FailureDigests));
 }
 
-/*
- *  TransportState class
- */
+/* Determine generation for a newly-saved state.
+   Must be unique among the loaded state and all states recorded in the history. */
+static Uns32 NextGeneration(const struct TransportState* st)
+{
+    Uns32 result = st->Stamp.Generation;
+    struct StateFile sf;
+    if (StateFile_Open(&sf, HISTORY_FILE_NAME)) {
+        struct HistoryEntry e;
+        if (HistoryEntry_ParseBefore(&e, &sf, sf.Size)) {
+            result = MAX(result, e.Stamp.Generation);
+        }
+        StateFile_Close(&sf);
+    }
+    return result + 1;
+}
+
+/* Save history entry for the state being saved.
+   Normally, the entry is appended to the history file. Every historyTurns turns,
+   the file is rewritten to drop entries older than historyTurns turns.
+   Note that appending happens immediately, before the host data is written, not with the staged state file.
+   If the run fails afterwards, the entry remains; RollBack() ignores it because its generation
+   does not match the state file. */
+static void SaveHistory(const struct TransportState* st, const struct TransportStamp* stamp, Uns16 historyTurns)
+{
+    // Build entry: everything that changed since loading
+    static const struct TransportShip EMPTY;
+    Uns16 numRecords = 0;
+    for (Uns16 i = 0; i < SHIP_NR; ++i) {
+        const Uns16 index = st->Index[i];
+        if (index != 0) {
+            const struct TransportShip* before = (index <= st->NumBaseline ? &st->Baseline[index-1] : &EMPTY);
+            if (memcmp(before, &st->Records[index-1], sizeof(*before)) != 0) {
+                ++numRecords;
+            }
+        }
+    }
+
+    struct Writer w;
+    Writer_Init(&w, HISTORY_OVERHEAD + HISTORY_HEADER_SIZE + numRecords * MAX_RECORD_SIZE);
+    Writer_Put32(&w, 0);
+    Writer_PutStamp(&w, stamp);
+    Writer_PutStamp(&w, &st->Stamp);
+    Writer_Put16(&w, numRecords);
+    for (Uns16 i = 0; i < SHIP_NR; ++i) {
+        const Uns16 index = st->Index[i];
+        if (index != 0) {
+            const struct TransportShip* before = (index <= st->NumBaseline ? &st->Baseline[index-1] : &EMPTY);
+            if (memcmp(before, &st->Records[index-1], sizeof(*before)) != 0) {
+                Writer_PutRecord(&w, i+1, before);
+            }
+        }
+    }
+    const Uns32 bodySize = w.Size - 4;
+    Writer_Put32(&w, Crc32c(0, w.Data + 4, bodySize));
+    Writer_Put32(&w, bodySize);
+    w.Data[0] = bodySize & 0xFF;
+    w.Data[1] = (bodySize >> 8) & 0xFF;
+    w.Data[2] = (bodySize >> 16) & 0xFF;
+    w.Data[3] = (bodySize >> 24) & 0xFF;
+
+    // Decide whether to append or rewrite
+    struct StateFile sf;
+    if (!StateFile_Open(&sf, HISTORY_FILE_NAME)) {
+        StateFile_Append(HISTORY_FILE_NAME, w.Data, w.Size);
+    } else {
+        struct HistoryEntry first, last;
+        if (sf.Size == 0
+            || (HistoryEntry_ParseAt(&first, &sf, 0)
+                && HistoryEntry_ParseBefore(&last, &sf, sf.Size)
+                && (Uns32) first.Stamp.Turn + 2*historyTurns >= stamp->Turn))
+        {
+            StateFile_Append(HISTORY_FILE_NAME, w.Data, w.Size);
+        } else {
+            // Keep the intact tail of the file that is still within the window.
+            size_t start = sf.Size;
+            struct HistoryEntry e;
+            while (HistoryEntry_ParseBefore(&e, &sf, start) && (Uns32) e.Stamp.Turn + historyTurns >= stamp->Turn) {
+                start = e.Start;
+            }
+
+            const size_t keep = sf.Size - start;
+            Uns8* data = malloc(keep + w.Size);
+            if (data == NULL) {
+                ErrorExit("Out of memory");
+            }
+            memcpy(data, sf.Data + start, keep);
+            memcpy(data + keep, w.Data, w.Size);
+            StateFile_Stage(HISTORY_FILE_NAME, data, keep + w.Size);
+            free(data);
+        }
+        StateFile_Close(&sf);
+    }
+    free(w.Data);
+}
 
-void TransportState_Load(struct TransportState* st)
+void TransportState_Load(struct TransportState* st, enum TransportPhase phase)
 {
     // Zero out state
-    memset(st, 0, sizeof(*st));
+    TransportState_Init(st);
+    st->RunPhase = phase;
 
     // Load the file
-    FILE* f = OpenInputFile(STATE_FILE_NAME, GAME_DIR_ONLY | NO_MISSING_ERROR);
-    if (f == NULL) {
+    struct StateFile sf;
+    if (!StateFile_Open(&sf, STATE_FILE_NAME)) {
         Warning("State file (%s) not found, starting with blank slate.", STATE_FILE_NAME);
         return;
     }
 
     // Version number
-    Uns16 version;
-    if (!DOSRead16(&version, 1, f) || version != 0) {
+    struct Reader r = { sf.Data, sf.Size, 0, False };
+    const Uns16 version = Reader_Get16(&r);
+    if (r.Error || version > STATE_VERSION) {
         Warning("State file (%s) has unrecognized format, ignoring it.", STATE_FILE_NAME);
-        fclose(f);
-        return;
+    } else if (version == 0) {
+        ParseVersion0(st, &r);
+    } else {
+        if (!ParseVersion1(st, &r)) {
+            // Do not continue; we would overwrite the file with a blank state.
+            StateFile_Close(&sf);
+            ErrorExit("State file (%s) is corrupt", STATE_FILE_NAME);
+        }
     }
-
-    // Read as much as we get to survive a possible Host500 > Host999 transition.
-    int shipId = 0;
-    struct TransportShip* info;
-    while ((info = TransportState_Ship(st, ++shipId)) != 0) {
-        if (!DOSRead16(info->Beams, BEAM_NR, f)
-            || !DOSRead16(info->Launchers, TORP_NR, f)
-            || !DOSRead16(info->Engines, ENGINE_NR, f))
-        {
-            break;
+    StateFile_Close(&sf);
+
+    // History
+    if (phase != TP_None) {
+        RollBack(st, phase);
+        if (st->NumRecords != 0) {
+            st->Baseline = malloc(st->NumRecords * sizeof(*st->Baseline));
+            if (st->Baseline == NULL) {
+                ErrorExit("Out of memory");
+            }
+            memcpy(st->Baseline, st->Records, st->NumRecords * sizeof(*st->Baseline));
         }
+        st->NumBaseline = st->NumRecords;
     }
-
-    fclose(f);
 }
 
-void TransportState_Save(struct TransportState* st)
+void TransportState_Save(struct TransportState* st, const struct Config* c)
 {
-    FILE* f = OpenOutputFile(STATE_FILE_NAME, GAME_DIR_ONLY | NO_MISSING_ERROR);
-    assert(f);
+    assert(st->RunPhase != TP_None);
+    const struct TransportStamp stamp = { Turn(), st->RunPhase, NextGeneration(st) };
 
-    // Version number
-    Uns16 version = 0;
-    Boolean ok = DOSWrite16(&version, 1, f);
+    // Count records
+    Uns16 numRecords = 0;
+    for (Uns16 shipId = TransportState_Next(st, 0); shipId != 0; shipId = TransportState_Next(st, shipId)) {
+        ++numRecords;
+    }
 
-    // Content
-    int shipId = 0;
-    struct TransportShip* info;
-    while (ok && (info = TransportState_Ship(st, ++shipId)) != 0) {
-        ok = DOSWrite16(info->Beams, BEAM_NR, f)
-            && DOSWrite16(info->Launchers, TORP_NR, f)
-            && DOSWrite16(info->Engines, ENGINE_NR, f);
+    // Forget reports of ships that no longer carry anything, and failures that did not recur.
+    // Failures are only checked after movement; keep them when saving before movement.
+    Uns16 numDigests = 0;
+    for (Uns16 i = 0; i < SHIP_NR; ++i) {
+        if (!TransportShip_HasComponents(TransportState_Find(st, i+1))) {
+            st->ReportDigests[i] = 0;
+        }
+        if (st->RunPhase == TP_AfterMovement && (st->FailuresSeen[i / 32] & (1UL << (i % 32))) == 0) {
+            st->FailureDigests[i] = 0;
+        }
+        if (st->ReportDigests[i] != 0 || st->FailureDigests[i] != 0) {
+            ++numDigests;
+        }
     }
 
-    if (!ok) {
-        Warning("Error saving state file (%s).", STATE_FILE_NAME);
+    // Build file image
+    struct Writer w;
+    Writer_Init(&w, STATE_HEADER_SIZE + numRecords * (MAX_RECORD_SIZE + 6 + 10) + 4 + 2 + numDigests * 10 + STATE_TRAILER_SIZE);
+    Writer_Put16(&w, STATE_VERSION);
+    Writer_Put16(&w, SHIP_NR);
+    Writer_PutStamp(&w, &stamp);
+    Writer_Put16(&w, numRecords);
+    for (Uns16 shipId = TransportState_Next(st, 0); shipId != 0; shipId = TransportState_Next(st, shipId)) {
+        Writer_PutRecord(&w, shipId, TransportState_Find(st, shipId));
     }
-    fclose(f);
+
+    const size_t countPos = w.Size;
+    Uns16 numFingerprints = 0;
+    Writer_Put16(&w, 0);
+    for (Uns16 shipId = TransportState_Next(st, 0); shipId != 0; shipId = TransportState_Next(st, shipId)) {
+        const Uns32 fingerprint = *TransportState_TrimFingerprint(st, shipId);
+        if (fingerprint != 0) {
+            Writer_Put16(&w, shipId);
+            Writer_Put32(&w, fingerprint);
+            ++numFingerprints;
+        }
+    }
+    w.Data[countPos] = numFingerprints & 0xFF;
+    w.Data[countPos+1] = numFingerprints >> 8;
+
+    const size_t identityCountPos = w.Size;
+    Uns16 numIdentities = 0;
+    Writer_Put16(&w, 0);
+    for (Uns16 shipId = TransportState_Next(st, 0); shipId != 0; shipId = TransportState_Next(st, shipId)) {
+        const struct TransportIdentity* id = TransportState_Identity(st, shipId);
+        if (id->Hull != 0) {
+            Writer_Put16(&w, shipId);
+            Writer_Put16(&w, id->Hull);
+            Writer_Put16(&w, id->Owner);
+            Writer_Put32(&w, id->NameHash);
+            ++numIdentities;
+        }
+    }
+    w.Data[identityCountPos] = numIdentities & 0xFF;
+    w.Data[identityCountPos+1] = numIdentities >> 8;
+
+    Writer_Put16(&w, numDigests);
+    for (Uns16 i = 0; i < SHIP_NR; ++i) {
+        if (st->ReportDigests[i] != 0 || st->FailureDigests[i] != 0) {
+            Writer_Put16(&w, i+1);
+            Writer_Put32(&w, st->ReportDigests[i]);
+            Writer_Put32(&w, st->FailureDigests[i]);
+        }
+    }
+    Writer_Put32(&w, Crc32c(0, w.Data, w.Size));
+
+    // Write it. The file is replaced when the host data is saved.
+    StateFile_Stage(STATE_FILE_NAME, w.Data, w.Size);
+    free(w.Data);
+
+    // History
+    if (c->StateHistoryTurns != 0) {
+        SaveHistory(st, &stamp, c->StateHistoryTurns);
+    }
+}
+
+void TransportState_Free(struct TransportState* st)
+{
+    free(st->Records);
+    free(st->TrimFingerprints);
+    free(st->Identities);
+    free(st->Baseline);
+    TransportState_Init(st);
 }
 
 struct TransportShip* TransportState_Ship(struct TransportState* st, Uns16 shipId)
 {
-    if (st != NULL && shipId > 0 && shipId <= SHIP_NR) {
-        return &st->Ships[shipId-1];
+    if (st == NULL || shipId == 0 || shipId > SHIP_NR) {
+        return 0;
+    }
+
+    Uns16* pIndex = &st->Index[shipId-1];
+    if (*pIndex == 0) {
+        // Allocate a new record
+        if (st->NumRecords >= st->RecordCapacity) {
+            const Uns16 newCapacity = (st->RecordCapacity == 0 ? 32 : MIN(SHIP_NR, 2*st->RecordCapacity));
+            struct TransportShip* newRecords = realloc(st->Records, newCapacity * sizeof(*newRecords));
+            if (newRecords == NULL) {
+                ErrorExit("Out of memory");
+            }
+            st->Records = newRecords;
+            Uns32* newFingerprints = realloc(st->TrimFingerprints, newCapacity * sizeof(*newFingerprints));
+            if (newFingerprints == NULL) {
+                ErrorExit("Out of memory");
+            }
+            st->TrimFingerprints = newFingerprints;
+            struct TransportIdentity* newIdentities = realloc(st->Identities, newCapacity * sizeof(*newIdentities));
+            if (newIdentities == NULL) {
+                ErrorExit("Out of memory");
+            }
+            st->Identities = newIdentities;
+            st->RecordCapacity = newCapacity;
+        }
+        memset(&st->Records[st->NumRecords], 0, sizeof(st->Records[0]));
+        st->TrimFingerprints[st->NumRecords] = 0;
+        memset(&st->Identities[st->NumRecords], 0, sizeof(st->Identities[0]));
+        *pIndex = ++st->NumRecords;
+    }
+    return &st->Records[*pIndex - 1];
+}
+
+const struct TransportShip* TransportState_Find(const struct TransportState* st, Uns16 shipId)
+{
+    if (st != NULL && shipId > 0 && shipId <= SHIP_NR && st->Index[shipId-1] != 0) {
+        return &st->Records[st->Index[shipId-1] - 1];
     } else {
         return 0;
     }
 }
 
+Uns16 TransportState_Next(const struct TransportState* st, Uns16 shipId)
+{
+    // Bit index of first candidate is shipId (=Id-1 of next ship)
+    Uns32 bit = shipId;
+    while (bit < SHIP_NR) {
+        const Uns32 word = st->Carriers[bit / 32] >> (bit % 32);
+        if (word != 0) {
+            // Find lowest set bit
+            Uns32 n = 0;
+            while (((word >> n) & 1) == 0) {
+                ++n;
+            }
+            return (bit + n < SHIP_NR ? bit + n + 1 : 0);
+        }
+        bit = (bit / 32 + 1) * 32;
+    }
+    return 0;
+}
+
+Boolean TransportState_IsEmpty(const struct TransportState* st)
+{
+    return TransportState_Next(st, 0) == 0;
+}
+
 /*
  *  TransportShip class
  */
 
 Boolean TransportShip_HasComponents(const struct TransportShip* sh)
 {
-    return (sh != NULL
-            && (AnyNonzero(sh->Engines, ENGINE_NR)
-                || AnyNonzero(sh->Beams, BEAM_NR)
-                || AnyNonzero(sh->Launchers, TORP_NR)));
+    return sh != NULL
+        && AnyNonzero(sh->Slots, TRANSPORT_SLOT_NR);
+}
+
+int TransportShip_SlotIndex(BaseTech_Def type, Uns16 slot)
+{
+    switch (type) {
+     case ENGINE_TECH:
+        return (slot > 0 && slot <= ENGINE_NR ? TRANSPORT_ENGINE_SLOT   + slot-1 : TRANSPORT_SLOT_NR);
+     case BEAM_TECH:
+        return (slot > 0 && slot <= BEAM_NR   ? TRANSPORT_BEAM_SLOT     + slot-1 : TRANSPORT_SLOT_NR);
+     case TORP_TECH:
+        return (slot > 0 && slot <= TORP_NR   ? TRANSPORT_LAUNCHER_SLOT + slot-1 : TRANSPORT_SLOT_NR);
+     default:
+        return TRANSPORT_SLOT_NR;
+    }
 }
 
 static void TransportShip_Clear(struct TransportShip* sh)
@@ -231,15 +888,8 @@ static void TransportShip_Clear(struct TransportShip* sh)
 
 Uns16 TransportShip_Cargo(const struct TransportShip* sh, BaseTech_Def type, Uns16 slot)
 {
-    Uns16 result = 0;
-    if (sh != NULL) {
-        switch (type) {
-         case ENGINE_TECH: result = (slot > 0 && slot <= ENGINE_NR ? sh->Engines[slot-1]   : 0); break;
-         case BEAM_TECH:   result = (slot > 0 && slot <= BEAM_NR   ? sh->Beams[slot-1]     : 0); break;
-         case TORP_TECH:   result = (slot > 0 && slot <= TORP_NR   ? sh->Launchers[slot-1] : 0); break;
-         default:;
-        }
-    }
+    const int index = TransportShip_SlotIndex(type, slot);
+    const Uns16 result = (sh != NULL && index < TRANSPORT_SLOT_NR ? sh->Slots[index] : 0);
     // Info("##  TransportShip_Cargo(%p,%d,%d) => %d", (void*) sh, type, slot, result);
     return result;
 }
@@ -247,39 +897,18 @@ Uns16 TransportShip_Cargo(const struct TransportShip* sh, BaseTech_Def type, Uns
 static void TransportShip_PutCargo(struct TransportShip* sh, BaseTech_Def type, Uns16 slot, Uns16 amount)
 {
     // Info("##  TransportShip_PutCargo(%p,%d,%d) <= %d", (void*) sh, type, slot, amount);
-    if (sh != NULL) {
-        switch (type) {
-         case ENGINE_TECH:
-            if (slot > 0 && slot <= ENGINE_NR) {
-                sh->Engines[slot-1] = amount;
-            }
-            break;
-         case BEAM_TECH:
-            if (slot > 0 && slot <= BEAM_NR) {
-                sh->Beams[slot-1] = amount;
-            }
-            break;
-         case TORP_TECH:
-            if (slot > 0 && slot <= TORP_NR) {
-                sh->Launchers[slot-1] = amount;
-            }
-            break;
-         default:;
-        }
+    const int index = TransportShip_SlotIndex(type, slot);
+    if (sh != NULL && index < TRANSPORT_SLOT_NR) {
+        sh->Slots[index] = amount;
     }
 }
 
-static Uns16 TransportShip_CargoMass(const struct TransportShip* sh, const struct Config* c)
+static Uns32 TransportShip_CargoMass(const struct TransportShip* sh, const struct Profiles* p)
 {
-    Uns16 total = 0;
-    for (int i = 1; i <= ENGINE_NR; ++i) {
-        total += ComponentMass(c, ENGINE_TECH, i) * TransportShip_Cargo(sh, ENGINE_TECH, i);
-    }
-    for (int i = 1; i <= BEAM_NR; ++i) {
-        total += ComponentMass(c, BEAM_TECH, i) * TransportShip_Cargo(sh, BEAM_TECH, i);
-    }
-    for (int i = 1; i <= TORP_NR; ++i) {
-        total += ComponentMass(c, TORP_TECH, i) * TransportShip_Cargo(sh, TORP_TECH, i);
+    // Plain loop over contiguous arrays; compilers vectorize this.
+    Uns32 total = 0;
+    for (int i = 0; i < TRANSPORT_SLOT_NR; ++i) {
+        total += (Uns32) sh->Slots[i] * p->ComponentMass[i];
     }
     return total;
 }
@@ -288,13 +917,13 @@ static Uns16 TransportShip_CargoMass(const struct TransportShip* sh, const struc
  *  Rule Configuration
  */
 
-static Boolean ShipCanLoadComponents(Uns16 shipId, const struct Config* c)
+static Boolean ShipCanLoadComponents(const struct Snapshot* s, Uns16 shipId, const struct Config* c)
 {
-    if (c->FreighterCarryOnly && (ShipBeamNumber(shipId) > 0 || ShipTubeNumber(shipId) > 0 || ShipBays(shipId) > 0)) {
+    if (c->FreighterCarryOnly && (s->Ships.NumBeams[shipId] > 0 || s->Ships.NumTubes[shipId] > 0 || s->Ships.NumBays[shipId] > 0)) {
         return False;
     }
 
-    if (c->NonCloakerCarryOnly && ShipCanCloak(shipId)) {
+    if (c->NonCloakerCarryOnly && s->Ships.CanCloak[shipId]) {
         return False;
     }
 
@@ -315,59 +944,121 @@ static Uns16 ShipCanAcceptComponent(const struct TransportShip* sh, const struct
  *  Action
  */
 
-static void GetComponent(struct TransportShip* sh, const struct Config* c, Uns16 shipId, Uns16 planetId, BaseTech_Def type, Uns16 slot)
+/* Components available for loading at one base, indexed by TransportShip_SlotIndex().
+   The last element is always 0. */
+struct BaseSurplus {
+    Uns16 Count[TRANSPORT_SLOT_NR+1];
+};
+
+static void InitBaseSurplus(struct BaseSurplus* bs, const struct Snapshot* s, Uns16 planetId)
+{
+    // Keep components needed for the build order
+    const Uns16* reserved = s->Profiles.Bases[planetId].ReservedComponents;
+    for (int i = 0; i <= TRANSPORT_SLOT_NR; ++i) {
+        bs->Count[i] = 0;
+    }
+    for (Uns16 i = 1; i <= ENGINE_NR; ++i) {
+        const int index = TransportShip_SlotIndex(ENGINE_TECH, i);
+        const Uns16 n = s->Bases.Engines[planetId][i-1];
+        bs->Count[index] = (n > reserved[index] ? n - reserved[index] : 0);
+    }
+    for (Uns16 i = 1; i <= BEAM_NR; ++i) {
+        const int index = TransportShip_SlotIndex(BEAM_TECH, i);
+        const Uns16 n = s->Bases.Beams[planetId][i-1];
+        bs->Count[index] = (n > reserved[index] ? n - reserved[index] : 0);
+    }
+    for (Uns16 i = 1; i <= TORP_NR; ++i) {
+        const int index = TransportShip_SlotIndex(TORP_TECH, i);
+        const Uns16 n = s->Bases.Tubes[planetId][i-1];
+        bs->Count[index] = (n > reserved[index] ? n - reserved[index] : 0);
+    }
+}
+
+/* Recurring failure conditions. */
+enum TransportFailure {
+    TF_LoadNotPermitted = 1,
+    TF_LoadNoParts,
+    TF_LoadConflictingParts,
+    TF_LoadNoSpace,
+    TF_UnloadNoParts
+};
+
+/* Record a failure. Returns true if the failure message should be sent,
+   i.e. the ship did not have the same failure last turn, or a reminder is due. */
+static Boolean NoteFailure(struct TransportState* st, Uns16 shipId, enum TransportFailure what, Uns16 planetId, BaseTech_Def type, Uns16 slot)
 {
+    const Uns16 key[] = { what, planetId, type, slot };
+    const Uns32 digest = Crc32c(0, key, sizeof(key)) | 1;
+    const Uns32 bit = shipId - 1;
+    const Boolean changed = (st->FailureDigests[bit] != digest);
+    st->FailureDigests[bit] = digest;
+    st->FailuresSeen[bit / 32] |= 1UL << (bit % 32);
+    return changed || st->Remind;
+}
+
+static void GetComponent(struct Snapshot* s, struct TransportState* st, struct BaseSurplus* bs, struct TransportShip* sh, const struct Config* c, Uns16 shipId, Uns16 planetId, BaseTech_Def type, Uns16 slot)
+{
+    const RaceType_Def owner = s->Ships.Owner[shipId];
+
     // Ship must be allowed to load components
-    if (!ShipCanLoadComponents(shipId, c)) {
+    if (!ShipCanLoadComponents(s, shipId, c)) {
         Info("\t(-) Ship %d: not allowed to load components", shipId);
-        Message_Transport_LoadNotPermitted(ShipOwner(shipId), shipId);
+        if (NoteFailure(st, shipId, TF_LoadNotPermitted, planetId, type, slot)) {
+            Message_Transport_LoadNotPermitted(owner, shipId);
+        }
         return;
     }
 
     // Base must have components
-    const Uns16 baseComponents = BaseComponents(planetId, type, slot);
-    const Uns16 reservedComponents = BaseReservedComponents(planetId, type, slot);
-    if (baseComponents <= reservedComponents) {
+    Uns16* surplus = &bs->Count[TransportShip_SlotIndex(type, slot)];
+    if (*surplus == 0) {
         Info("\t(-) Ship %d, base %d: load: no matching component on base", shipId, planetId);
-        Message_Transport_LoadNoParts(ShipOwner(shipId), shipId, planetId);
+        if (NoteFailure(st, shipId, TF_LoadNoParts, planetId, type, slot)) {
+            Message_Transport_LoadNoParts(owner, shipId, planetId);
+        }
         return;
     }
 
     // Ship must be able to accept components of this type
     if (!ShipCanAcceptComponent(sh, c, type, slot)) {
         Info("\t(-) Ship %d, base %d: load: conflicting component on ship", shipId, planetId);
-        Message_Transport_LoadConflictingParts(ShipOwner(shipId), shipId);
+        if (NoteFailure(st, shipId, TF_LoadConflictingParts, planetId, type, slot)) {
+            Message_Transport_LoadConflictingParts(owner, shipId);
+        }
         return;
     }
 
     // Determine mass of component
-    const Uns16 compMass = ComponentMass(c, type, slot);
+    const Uns16 compMass = ComponentMass(&s->Profiles, type, slot);
 
     // Determine mass already on ship
-    const Uns16 shipCargo = ShipCargoMass(shipId) + TransportShip_CargoMass(sh, c);
-    const Uns16 maxCargo = HullCargoCapacity(ShipHull(shipId));
+    const Uns32 shipCargo = Snapshot_ShipCargoMass(s, shipId) + TransportShip_CargoMass(sh, &s->Profiles);
+    const Uns16 maxCargo = HullCargoCapacity(s->Ships.Hull[shipId]);
 
     // Determine maximum number of components
     // Careful in case ship is already overloaded.
     const Uns16 maxComponents = (shipCargo >= maxCargo ? 0 : (maxCargo - shipCargo) / compMass);
     if (maxComponents == 0) {
         Info("\t(-) Ship %d, base %d: load: out of space on ship", shipId, planetId);
-        Message_Transport_LoadNoSpace(ShipOwner(shipId), shipId);
+        if (NoteFailure(st, shipId, TF_LoadNoSpace, planetId, type, slot)) {
+            Message_Transport_LoadNoSpace(owner, shipId);
+        }
         return;
     }
 
     // OK, do it
-    const Uns16 numComponents = MIN(baseComponents - reservedComponents, maxComponents);
+    const Uns16 numComponents = MIN(*surplus, maxComponents);
     TransportShip_PutCargo(sh, type, slot, TransportShip_Cargo(sh, type, slot) + numComponents);
-    PutBaseComponents(planetId, type, slot, baseComponents - numComponents);
+    Snapshot_PutBaseComponents(s, planetId, type, slot, Snapshot_BaseComponents(s, planetId, type, slot) - numComponents);
+    *surplus -= numComponents;
     Info("\t(+) Ship %d, base %d: loaded %d %s-%d", shipId, planetId, numComponents, ComponentTypeName(type), slot);
-    Message_Transport_LoadSuccess(ShipOwner(shipId), shipId, planetId, numComponents);
+    Message_Transport_LoadSuccess(owner, shipId, planetId, numComponents);
 }
 
-static Uns16 UnloadSingleComponent(struct TransportShip* sh, Uns16 planetId, BaseTech_Def type, Uns16 slot, Uns16 shipComponents)
+static Uns16 UnloadSingleComponent(struct Snapshot* s, struct TransportShip* sh, Uns16 planetId, BaseTech_Def type, Uns16 slot, Uns16 shipComponents)
 {
     // Determine number of components on base
-    const Uns16 baseComponents = BaseComponents(planetId, type, slot);
+    const Uns16 baseComponents = Snapshot_BaseComponents(s, planetId, type, slot);
 
     // Determine how many we can add without overflowing
     const Uns16 maxComponents = (baseComponents >= MAX_BASE_COMPONENTS ? 0 : MAX_BASE_COMPONENTS - baseComponents);
@@ -377,73 +1068,90 @@ static Uns16 UnloadSingleComponent(struct TransportShip* sh, Uns16 planetId, Bas
 
     // Move them
     TransportShip_PutCargo(sh, type, slot, TransportShip_Cargo(sh, type, slot) - numComponents);
-    PutBaseComponents(planetId, type, slot, baseComponents + numComponents);
+    Snapshot_PutBaseComponents(s, planetId, type, slot, baseComponents + numComponents);
     return numComponents;
 }
 
-static void UnloadComponent(struct TransportShip* sh, Uns16 shipId, Uns16 planetId, BaseTech_Def type, Uns16 slot)
+static void UnloadComponent(struct Snapshot* s, struct TransportState* st, struct TransportShip* sh, Uns16 shipId, Uns16 planetId, BaseTech_Def type, Uns16 slot)
 {
     // Determine number of components on ship
     Uns16 shipComponents = TransportShip_Cargo(sh, type, slot);
     if (shipComponents == 0) {
         Info("\t(-) Ship %d, base %d: unload: no matching component on ship", shipId, planetId);
-        Message_Transport_UnloadNoParts(ShipOwner(shipId), shipId);
+        if (NoteFailure(st, shipId, TF_UnloadNoParts, planetId, type, slot)) {
+            Message_Transport_UnloadNoParts(s->Ships.Owner[shipId], shipId);
+        }
         return;
     }
 
     // Unload and generate messages
     // For now, do not special-case "no space on base".
-    Uns16 numComponents = UnloadSingleComponent(sh, planetId, type, slot, shipComponents);
+    Uns16 numComponents = UnloadSingleComponent(s, sh, planetId, type, slot, shipComponents);
     Info("\t(+) Ship %d, base %d: unloaded %d %s-%d", shipId, planetId, numComponents, ComponentTypeName(type), slot);
-    Message_Transport_UnloadSuccess(ShipOwner(shipId), shipId, planetId, numComponents);
+    Message_Transport_UnloadSuccess(s->Ships.Owner[shipId], shipId, planetId, numComponents);
 }
 
-static void UnloadAll(struct TransportShip* sh, Uns16 shipId, Uns16 planetId)
+static void UnloadAll(struct Snapshot* s, struct TransportState* st, struct TransportShip* sh, Uns16 shipId, Uns16 planetId)
 {
     // Unload everything
     Uns32 total = 0;
     for (Uns16 i = 1; i <= ENGINE_NR; ++i) {
-        total += UnloadSingleComponent(sh, planetId, ENGINE_TECH, i, TransportShip_Cargo(sh, ENGINE_TECH, i));
+        total += UnloadSingleComponent(s, sh, planetId, ENGINE_TECH, i, TransportShip_Cargo(sh, ENGINE_TECH, i));
     }
     for (Uns16 i = 1; i <= BEAM_NR; ++i) {
-        total += UnloadSingleComponent(sh, planetId, BEAM_TECH, i, TransportShip_Cargo(sh, BEAM_TECH, i));
+        total += UnloadSingleComponent(s, sh, planetId, BEAM_TECH, i, TransportShip_Cargo(sh, BEAM_TECH, i));
     }
     for (Uns16 i = 1; i <= TORP_NR; ++i) {
-        total += UnloadSingleComponent(sh, planetId, TORP_TECH, i, TransportShip_Cargo(sh, TORP_TECH, i));
+        total += UnloadSingleComponent(s, sh, planetId, TORP_TECH, i, TransportShip_Cargo(sh, TORP_TECH, i));
     }
 
     // Generate messages
     // For now, do not distinguish between "nothing aboard" and "no space on base" which both end up with total=0.
     Info("\t(+) Ship %d, base %d: unloaded %ld components", shipId, planetId, (long) total);
     if (total == 0) {
-        Message_Transport_UnloadNoParts(ShipOwner(shipId), shipId);
+        if (NoteFailure(st, shipId, TF_UnloadNoParts, planetId, 0, 0)) {
+            Message_Transport_UnloadNoParts(s->Ships.Owner[shipId], shipId);
+        }
     } else {
-        Message_Transport_UnloadSuccess(ShipOwner(shipId), shipId, planetId, total);
+        Message_Transport_UnloadSuccess(s->Ships.Owner[shipId], shipId, planetId, total);
     }
 }
 
-static void UntagShips()
+static void UpdateShipTags(const struct Snapshot* s, const struct TransportState* st)
 {
-    for (Uns16 shipId = 1; shipId <= SHIP_NR; ++shipId) {
-        char buf[SHIPNAME_SIZE+1];
-        if (IsShipExist(shipId)) {
+    /*
+     *  Only ships whose tag status changes are renamed.
+     *  The tagged list contains all ships whose name started with the prefix when we started,
+     *  i.e. carriers tagged last turn as well as ships named that way by players.
+     */
+    const size_t prefixLength = strlen(NAME_PREFIX);
+    Uns32 tagged[(SHIP_NR + 31) / 32];
+    memset(tagged, 0, sizeof(tagged));
+
+    // Remove tag from ships that no longer carry components
+    const struct ScheduleList list = Schedule_Get(&s->Schedule, SS_Tagged);
+    for (Uns16 n = 0; n < list.Count; ++n) {
+        const Uns16 shipId = list.Ids[n];
+        const Uns32 bit = shipId - 1;
+        tagged[bit / 32] |= 1UL << (bit % 32);
+        if (!TransportShip_HasComponents(TransportState_Find(st, shipId))) {
+            char buf[SHIPNAME_SIZE+1];
             ShipName(shipId, buf);
-            if (memcmp(buf, NAME_PREFIX, strlen(NAME_PREFIX)) == 0) {
-                PutShipName(shipId, &buf[strlen(NAME_PREFIX)]);
+            if (memcmp(buf, NAME_PREFIX, prefixLength) == 0) {
+                HostData_PutShipName(shipId, &buf[prefixLength]);
             }
         }
     }
-}
 
-static void TagShips(struct TransportState* st)
-{
-    for (Uns16 shipId = 1; shipId <= SHIP_NR; ++shipId) {
-        if (IsShipExist(shipId) && TransportShip_HasComponents(TransportState_Ship(st, shipId))) {
+    // Add tag to carriers that do not have it yet
+    for (Uns16 shipId = TransportState_Next(st, 0); shipId != 0; shipId = TransportState_Next(st, shipId)) {
+        const Uns32 bit = shipId - 1;
+        if ((tagged[bit / 32] & (1UL << (bit % 32))) == 0) {
             // Rename it; build new name in-place.
             char buf[SHIPNAME_SIZE + 10];
             strcpy(buf, NAME_PREFIX);
-            ShipName(shipId, &buf[strlen(NAME_PREFIX)]);
-            PutShipName(shipId, buf);
+            ShipName(shipId, &buf[prefixLength]);
+            HostData_PutShipName(shipId, buf);
         }
     }
 }
@@ -454,111 +1162,228 @@ static void TagShips(struct TransportState* st)
 
 struct ReportShip_State {
     Uns32 args[2];
+    RaceType_Def owner;
     struct Message m;
-    const struct Config* config;
+    const struct Profiles* profiles;
+    Boolean utilRecords;
+    Boolean quiet;                  /* True to write util.dat records only, no message. */
+    Boolean codes;                  /* True to show the unload friendly code for each part. */
 };
 
+/* Record a ship's report. Returns true if the report message should be sent,
+   i.e. its content changed since last turn, or a reminder is due. */
+static Boolean NoteReport(struct TransportState* st, Uns16 shipId, RaceType_Def owner, const struct TransportShip* sh)
+{
+    const Uns16 key = owner;
+    const Uns32 digest = Crc32c(Crc32c(0, &key, sizeof(key)), sh->Slots, sizeof(sh->Slots)) | 1;
+    const Boolean changed = (st->ReportDigests[shipId-1] != digest);
+    st->ReportDigests[shipId-1] = digest;
+    return changed || st->Remind;
+}
+
 static void ReportShip_Add(struct ReportShip_State* st, const struct TransportShip* sh, BaseTech_Def type, Uns16 slot, const char* name, const char* fcPrefix)
 {
     const Uns16 amount = TransportShip_Cargo(sh, type, slot);
     if (amount != 0) {
         const Uns16 shipId = st->args[0];
-        if (st->m.Lines >= MAX_MESSAGE_LINES) {
-            const struct Language* lang = GetLanguageForPlayer(ShipOwner(shipId));
-            Message_Add(&st->m, lang->Continuation);
-            Message_Send(&st->m, ShipOwner(shipId));
-            Message_Init(&st->m);
-            Message_Format(&st->m,
-                           lang->ReportShip_Continuation,
-                           st->args, 2);
+        if (!st->quiet) {
+            char line[50];
+            if (st->codes) {
+                snprintf(line, sizeof(line), "%3d x %-20s [%s%d]\n", amount, name, fcPrefix, slot % 10);
+            } else {
+                snprintf(line, sizeof(line), "%3d x %s\n", amount, name);
+            }
+            Message_Add(&st->m, line);
+        }
+        if (st->utilRecords) {
+            Util_Transport_Component(st->owner, shipId, type, slot, amount, ComponentMass(st->profiles, type, slot));
         }
-
-        char line[50];
-        snprintf(line, sizeof(line), "%3d x %-20s [%s%d]\n", amount, name, fcPrefix, slot % 10);
-        Message_Add(&st->m, line);
-        Util_Transport_Component(ShipOwner(shipId), shipId, type, slot, amount, ComponentMass(st->config, type, slot));
     }
 }
 
-static void ReportShip(struct TransportShip* sh, const struct Config* c, Uns16 shipId)
+/* Add a ship's components to the report. */
+static void ReportShip_AddComponents(struct ReportShip_State* st, const struct TransportShip* sh)
 {
     char name[40];
+    for (Uns16 i = 1; i <= ENGINE_NR; ++i) {
+        ReportShip_Add(st, sh, ENGINE_TECH, i, EngineName(i, name), "UE");
+    }
+    for (Uns16 i = 1; i <= BEAM_NR; ++i) {
+        ReportShip_Add(st, sh, BEAM_TECH, i, BeamName(i, name), "UB");
+    }
+    for (Uns16 i = 1; i <= TORP_NR; ++i) {
+        ReportShip_Add(st, sh, TORP_TECH, i, TorpName(i, name), "UT");
+    }
+}
 
-    const struct Language* lang = GetLanguageForPlayer(ShipOwner(shipId));
-    const Uns16 totalCargo = TransportShip_CargoMass(sh, c);
+static void ReportShip(const struct Snapshot* s, struct TransportState* ts, const struct Config* c, Uns16 shipId)
+{
+    const struct TransportShip* sh = TransportState_Find(ts, shipId);
+    const RaceType_Def owner = s->Ships.Owner[shipId];
+    const struct Language* lang = GetLanguageForPlayer(owner);
+    const Uns32 totalCargo = TransportShip_CargoMass(sh, &s->Profiles);
     struct ReportShip_State st;
     st.args[0] = shipId;
     st.args[1] = totalCargo;
-    st.config = c;
+    st.owner = owner;
+    st.profiles = &s->Profiles;
+    st.utilRecords = c->TransportUtilRecords;
+    st.quiet = !NoteReport(ts, shipId, owner, sh);
+    st.codes = True;
     Message_Init(&st.m);
-    Message_Format(&st.m, lang->ReportShip_Header, st.args, 2);
-    Util_Transport_Summary(ShipOwner(shipId), shipId, totalCargo);
-
-    for (Uns16 i = 1; i <= ENGINE_NR; ++i) {
-        ReportShip_Add(&st, sh, ENGINE_TECH, i, EngineName(i, name), "UE");
+    if (!st.quiet) {
+        Message_Format(&st.m, lang->ReportShip_Header, st.args, 2);
     }
-    for (Uns16 i = 1; i <= BEAM_NR; ++i) {
-        ReportShip_Add(&st, sh, BEAM_TECH, i, BeamName(i, name), "UB");
+    if (st.utilRecords) {
+        Util_Transport_Summary(owner, shipId, MIN(totalCargo, 0xFFFF));
     }
-    for (Uns16 i = 1; i <= TORP_NR; ++i) {
-        ReportShip_Add(&st, sh, TORP_TECH, i, TorpName(i, name), "UT");
+    ReportShip_AddComponents(&st, sh);
+    if (!st.quiet) {
+        struct Message cont;
+        Message_Init(&cont);
+        Message_Format(&cont, lang->ReportShip_Continuation, st.args, 2);
+        Message_SendContinued(&st.m, &cont, owner);
     }
-
-    Message_Send(&st.m, ShipOwner(shipId));
 }
 
-static void ReportShips(struct TransportState* st, const struct Config* c)
+static void ReportFleet(const struct Snapshot* s, struct TransportState* ts, const struct Config* c, RaceType_Def owner)
 {
-    for (Uns16 shipId = 1; shipId <= SHIP_NR; ++shipId) {
-        if (IsShipExist(shipId) && TransportShip_HasComponents(TransportState_Ship(st, shipId))) {
-            ReportShip(TransportState_Ship(st, shipId), c, shipId);
+    /*
+     *  One manifest for all of a player's carriers whose report is due.
+     *  Each ship is sent as a message of its own with the same header line;
+     *  Message_Flush() packs them onto as few pages as possible.
+     *  Only the first one carries the manifest's introduction.
+     */
+    const struct Language* lang = GetLanguageForPlayer(owner);
+    struct ReportShip_State st;
+    st.args[0] = 0;
+    st.args[1] = 0;
+    st.owner = owner;
+    st.profiles = &s->Profiles;
+    st.utilRecords = c->TransportUtilRecords;
+    st.codes = True;
+
+    Boolean any = False;
+    for (Uns16 shipId = TransportState_Next(ts, 0); shipId != 0; shipId = TransportState_Next(ts, shipId)) {
+        if (s->Ships.Owner[shipId] == owner) {
+            const struct TransportShip* sh = TransportState_Find(ts, shipId);
+            const Uns32 totalCargo = TransportShip_CargoMass(sh, &s->Profiles);
+            st.quiet = !NoteReport(ts, shipId, owner, sh);
+            st.args[0] = shipId;
+            st.args[1] = totalCargo;
+            Message_Init(&st.m);
+            if (st.utilRecords) {
+                Util_Transport_Summary(owner, shipId, MIN(totalCargo, 0xFFFF));
+            }
+            if (!st.quiet) {
+                if (!any) {
+                    Message_Format(&st.m, lang->ReportDigest_Header, st.args, 2);
+                    any = True;
+                } else {
+                    Message_FormatHeader(&st.m, lang->ReportDigest_Header, st.args, 2);
+                }
+                Message_Format(&st.m, lang->ReportDigest_Ship, st.args, 2);
+            }
+            ReportShip_AddComponents(&st, sh);
+            if (!st.quiet) {
+                // Continuation pages repeat the ship's heading
+                struct Message cont;
+                Message_Init(&cont);
+                Message_Format(&cont, lang->ReportDigest_Continuation, st.args, 2);
+                Message_Format(&cont, lang->ReportDigest_Ship, st.args, 2);
+                Message_SendContinued(&st.m, &cont, owner);
+            }
         }
     }
 }
 
-/*
- *  Cargo Trimming
- */
-
-static Boolean RemoveComponent(struct TransportShip* sh, BaseTech_Def type, Uns16 limit)
+/* Add a ship's components of one type to a "Transport Manifest". */
+static void ReportManifest_Add(struct UtilTransportManifest* m, const struct TransportShip* sh, const struct Profiles* p, BaseTech_Def type, Uns16 count)
 {
-    for (Uns16 slot = 1; slot <= limit; ++slot) {
-        Uns16 have = TransportShip_Cargo(sh, type, slot);
-        if (have > 0) {
-            TransportShip_PutCargo(sh, type, slot, have-1);
-            return True;
+    for (Uns16 i = 1; i <= count; ++i) {
+        const Uns16 amount = TransportShip_Cargo(sh, type, i);
+        if (amount != 0) {
+            Util_TransportManifest_AddComponent(m, type, i, amount, ComponentMass(p, type, i));
         }
     }
-    return False;
 }
 
-static Boolean RemoveCargo(Uns16 shipId, CargoType_Def what, Uns16* acc, Uns16 limit)
+/* Write a player's "Transport Manifest" util.dat records. */
+static void ReportManifest(const struct Snapshot* s, const struct TransportState* ts, RaceType_Def owner)
 {
-    Uns16 have = ShipCargo(shipId, what);
-    Uns16 drop = MIN(have, MIN(*acc, limit));
-    if (drop != 0) {
-        PutShipCargo(shipId, what, have - drop);
-        *acc -= drop;
-        return True;
-    } else {
-        return False;
+    static struct UtilTransportManifest m;
+    Util_TransportManifest_Init(&m, owner);
+    for (Uns16 shipId = TransportState_Next(ts, 0); shipId != 0; shipId = TransportState_Next(ts, shipId)) {
+        if (s->Ships.Owner[shipId] == owner) {
+            const struct TransportShip* sh = TransportState_Find(ts, shipId);
+            Util_TransportManifest_AddShip(&m, shipId, MIN(TransportShip_CargoMass(sh, &s->Profiles), 0xFFFF));
+            ReportManifest_Add(&m, sh, &s->Profiles, ENGINE_TECH, ENGINE_NR);
+            ReportManifest_Add(&m, sh, &s->Profiles, BEAM_TECH, BEAM_NR);
+            ReportManifest_Add(&m, sh, &s->Profiles, TORP_TECH, TORP_NR);
+        }
     }
+    Util_TransportManifest_Finish(&m);
+}
+
+/* Tell the previous owner of a ship that its parts are lost, by message and "Transport Discarded" util.dat record. */
+static void ReportDiscarded(const struct Snapshot* s, const struct TransportState* ts, Uns16 shipId, RaceType_Def to)
+{
+    const struct TransportShip* sh = TransportState_Find(ts, shipId);
+    const struct Language* lang = GetLanguageForPlayer(to);
+    const Uns32 totalCargo = TransportShip_CargoMass(sh, &s->Profiles);
+
+    // Message; the parts cannot be unloaded anymore, so don't show friendly codes
+    struct ReportShip_State st;
+    st.args[0] = shipId;
+    st.args[1] = totalCargo;
+    st.owner = to;
+    st.profiles = &s->Profiles;
+    st.utilRecords = False;
+    st.quiet = False;
+    st.codes = False;
+    Message_Init(&st.m);
+    Message_Format(&st.m, lang->ReportDiscarded_Header, st.args, 2);
+    ReportShip_AddComponents(&st, sh);
+
+    struct Message cont;
+    Message_Init(&cont);
+    Message_Format(&cont, lang->ReportDiscarded_Continuation, st.args, 2);
+    Message_SendContinued(&st.m, &cont, to);
+
+    // util.dat
+    static struct UtilTransportManifest m;
+    Util_TransportDiscarded_Init(&m, to);
+    Util_TransportManifest_AddShip(&m, shipId, MIN(totalCargo, 0xFFFF));
+    ReportManifest_Add(&m, sh, &s->Profiles, ENGINE_TECH, ENGINE_NR);
+    ReportManifest_Add(&m, sh, &s->Profiles, BEAM_TECH, BEAM_NR);
+    ReportManifest_Add(&m, sh, &s->Profiles, TORP_TECH, TORP_NR);
+    Util_TransportManifest_Finish(&m);
 }
 
-static Boolean RemoveAmmo(Uns16 shipId, Uns16* acc, Uns16 limit)
+static void ReportShips(const struct Snapshot* s, struct TransportState* st, const struct Config* c)
 {
-    Uns16 have = ShipAmmunition(shipId);
-    Uns16 drop = MIN(have, MIN(*acc, limit));
-    if (drop != 0) {
-        PutShipAmmunition(shipId, have - drop);
-        *acc -= drop;
-        return True;
+    if (c->TransportDigest) {
+        for (RaceType_Def owner = 1; owner <= RACE_NR; ++owner) {
+            ReportFleet(s, st, c, owner);
+        }
     } else {
-        return False;
+        for (Uns16 shipId = TransportState_Next(st, 0); shipId != 0; shipId = TransportState_Next(st, shipId)) {
+            ReportShip(s, st, c, shipId);
+        }
+    }
+
+    if (c->TransportUtilManifest) {
+        for (RaceType_Def owner = 1; owner <= RACE_NR; ++owner) {
+            ReportManifest(s, st, owner);
+        }
     }
 }
 
-static void TrimSingleShipCargo(struct TransportShip* sh, const struct Config* c, Uns16 shipId)
+/*
+ *  Cargo Trimming
+ */
+
+static void TrimSingleShipCargo(struct Snapshot* s, struct TransportShip* sh, Uns16 shipId)
 {
     /*
        Things we do not do and why:
@@ -577,167 +1402,192 @@ static void TrimSingleShipCargo(struct TransportShip* sh, const struct Config* c
      */
 
     // Determine maximum mass for components.
-    const Uns16 maxTotalCargo = HullCargoCapacity(ShipHull(shipId));
+    const RaceType_Def owner = s->Ships.Owner[shipId];
+    const Uns16 maxTotalCargo = HullCargoCapacity(s->Ships.Hull[shipId]);
 
     // Pass 1: drop components that exceed the ship's cargo room
     // (e.g. a ship with 200 kt cargo room but 20 components)
-    Uns16 droppedComponents = 0;
-    Uns16 componentMass = TransportShip_CargoMass(sh, c);
-    const Uns16 originalMass = componentMass;
-    while (componentMass > maxTotalCargo) {
-        Boolean ok = False;
-        if (RemoveComponent(sh, BEAM_TECH, BEAM_NR)) {
-            ++droppedComponents;
-            componentMass = TransportShip_CargoMass(sh, c);
-            if (componentMass <= maxTotalCargo) {
-                break;
-            }
-            ok = True;
-        }
-        if (RemoveComponent(sh, TORP_TECH, TORP_NR)) {
-            ++droppedComponents;
-            componentMass = TransportShip_CargoMass(sh, c);
-            if (componentMass <= maxTotalCargo) {
-                break;
-            }
-            ok = True;
-        }
-        if (RemoveComponent(sh, ENGINE_TECH, ENGINE_NR)) {
-            ++droppedComponents;
-            componentMass = TransportShip_CargoMass(sh, c);
-            if (componentMass <= maxTotalCargo) {
-                break;
-            }
-            ok = True;
-        }
-        if (!ok) {
-            // Unable to trim more
-            break;
-        }
-    }
+    Uns32 componentMass = TransportShip_CargoMass(sh, &s->Profiles);
+    const Uns32 originalMass = componentMass;
+    const Uns16 droppedComponents = Trim_Components(sh, &s->Profiles, &componentMass, maxTotalCargo);
 
     // Report message
     if (droppedComponents != 0) {
-        const Uns16 droppedMass = originalMass - componentMass;
-        Info("\t(+) Ship %d: trimmed cargo: %d components, %d kt", shipId, droppedComponents, droppedMass);
-        Message_Transport_TrimmedComponents(ShipOwner(shipId), shipId, droppedComponents, droppedMass);
+        const Uns32 droppedMass = originalMass - componentMass;
+        Info("\t(+) Ship %d: trimmed cargo: %d components, %d kt", shipId, droppedComponents, (int) droppedMass);
+        Message_Transport_TrimmedComponents(owner, shipId, droppedComponents, MIN(droppedMass, 0xFFFF));
     }
 
     // Pass 2: trim excess cargo
     const Uns16 maxCargoMass = maxTotalCargo - componentMass;
-    const Uns16 cargoMass = ShipCargoMass(shipId);
+    const Uns16 cargoMass = Snapshot_ShipCargoMass(s, shipId);
     if (cargoMass > maxCargoMass) {
-        Uns16 toDrop = cargoMass - maxCargoMass;
-        while (toDrop > 0) {
-            // Remove from all types of cargo in equal amounts.
-            // To speed things up, remove more than just one during first iterations.
-            // If we got, say, 100 kt excess, we need to remove 100/6 = 16 from each type at least.
-            // If cargo is already equally distributed, this takes only few iterations.
-            // If only one type remains, this will eventually remove stuff in 1 kt increments,
-            // like the naive algorithm would do anyway.
-            Uns16 toDropNow = MAX(toDrop / 6, 1);
-            Boolean ok =
-                  RemoveCargo(shipId, TRITANIUM, &toDrop, toDropNow);
-            ok |= RemoveCargo(shipId, DURANIUM, &toDrop, toDropNow);
-            ok |= RemoveCargo(shipId, MOLYBDENUM, &toDrop, toDropNow);
-            ok |= RemoveCargo(shipId, SUPPLIES, &toDrop, toDropNow);
-            ok |= RemoveCargo(shipId, COLONISTS, &toDrop, toDropNow);
-            ok |= RemoveAmmo(shipId, &toDrop, toDropNow);
-            if (!ok) {
-                break;
+        Uns16 cargo[SHIP_CARGO_NR];
+        for (int i = 0; i < SHIP_CARGO_NR; ++i) {
+            cargo[i] = s->Ships.Cargo[shipId][i];
+        }
+        Trim_RegularCargo(cargo, cargoMass - maxCargoMass);
+        for (int i = 0; i < SHIP_CARGO_NR; ++i) {
+            if (cargo[i] != s->Ships.Cargo[shipId][i]) {
+                Snapshot_PutShipCargo(s, shipId, i, cargo[i]);
             }
         }
 
-        const Uns16 droppedMass = cargoMass - ShipCargoMass(shipId);
+        const Uns16 droppedMass = cargoMass - Snapshot_ShipCargoMass(s, shipId);
         Info("\t(+) Ship %d: trimmed regular cargo: %d kt", shipId, droppedMass);
-        Message_Transport_TrimmedCargo(ShipOwner(shipId), shipId, droppedMass);
+        Message_Transport_TrimmedCargo(owner, shipId, droppedMass);
     }
 }
 
-static void TrimCargo(struct TransportState* st, const struct Config* c)
+/* Compute trim fingerprint.
+   This covers everything that decides whether a ship is overloaded: hull, regular cargo, components,
+   and component masses (rules). A ship whose fingerprint is unchanged since it was last trimmed
+   is not overloaded and need not be checked again. Never returns 0. */
+static Uns32 TrimFingerprint(const struct Snapshot* s, const struct TransportShip* sh, Uns16 shipId, Uns32 rules)
 {
-    for (Uns16 shipId = 1; shipId <= SHIP_NR; ++shipId) {
-        struct TransportShip* sh = TransportState_Ship(st, shipId);
-        if (IsShipExist(shipId)) {
-            // Trim single ship cargo
-            if (TransportShip_HasComponents(sh)) {
-                TrimSingleShipCargo(sh, c, shipId);
+    const Uns16 ship[] = {
+        s->Ships.Hull[shipId],
+        Snapshot_ShipCargoMass(s, shipId),
+        s->Ships.Cargo[shipId][SC_Ammo],
+    };
+    Uns32 result = Crc32c(rules, ship, sizeof(ship));
+    result = Crc32c(result, sh->Slots, sizeof(sh->Slots));
+    return result != 0 ? result : 1;
+}
+
+static void TrimCargo(struct Snapshot* s, struct TransportState* st)
+{
+    const Uns32 rules = Crc32c(0, s->Profiles.ComponentMass, sizeof(s->Profiles.ComponentMass));
+    int numSkipped = 0;
+    for (Uns16 shipId = TransportState_Next(st, 0); shipId != 0; shipId = TransportState_Next(st, shipId)) {
+        Uns32* fingerprint = TransportState_TrimFingerprint(st, shipId);
+        if (s->Ships.Exists[shipId]) {
+            // Trim single ship cargo, unless unchanged since last time
+            struct TransportShip* sh = TransportState_Ship(st, shipId);
+            if (*fingerprint == TrimFingerprint(s, sh, shipId, rules)) {
+                ++numSkipped;
+            } else {
+                TrimSingleShipCargo(s, sh, shipId);
+                *fingerprint = TrimFingerprint(s, sh, shipId, rules);
             }
         } else {
             // Ship does not exist; just discard all the stuff
-            TransportShip_Clear(sh);
+            TransportShip_Clear(TransportState_Ship(st, shipId));
+            *fingerprint = 0;
         }
+        TransportState_Sync(st, shipId);
+    }
+    if (numSkipped != 0) {
+        Info("\t%d ship(s) unchanged since last trim, skipped", numSkipped);
     }
 }
 
-static void HandleNewShips(struct TransportState* st)
+/* Get current identity of a ship. */
+static void GetShipIdentity(const struct Snapshot* s, Uns16 shipId, struct TransportIdentity* id)
+{
+    char name[SHIPNAME_SIZE+1];
+    ShipName(shipId, name);
+    id->Hull = s->Ships.Hull[shipId];
+    id->Owner = s->Ships.Owner[shipId];
+    id->NameHash = Crc32c(0, name, strlen(name));
+}
+
+/* Check identities of all carriers. Returns false if some were not known. */
+static Boolean CheckShipIdentities(const struct Snapshot* s, struct TransportState* st)
 {
     /*
      *  A ship may be destroyed and rebuilt the same turn.
      *  If it was carrying components, we must reset its cargo.
      *  Unfortunately, there is no easy way to detect that.
      *
-     *  The approach I'm taking here is to scan UTIL.TMP fo "ship built" records,
-     *  and reset all ships seen.
+     *  We remember hull, owner and name of each carrier at the end of the transport phase.
+     *  A change of any of them is taken as a new ship. The most common case is a carrier
+     *  rebuilt by the same owner with the same hull; only its name differs.
+     *  Captured or renamed carriers therefore lose their cargo, too;
+     *  the previous owner is told which parts were lost.
+     *
+     *  Names are compared as loaded, i.e. including the tag; UpdateShipTags() changes them at the end.
+     *  With TagSpecialTransport, the recorded name of a carrier always has the tag, and a newly-built
+     *  ship never has it, so a missing tag counts as a name change.
+     */
+    Boolean allKnown = True;
+    for (Uns16 shipId = TransportState_Next(st, 0); shipId != 0; shipId = TransportState_Next(st, shipId)) {
+        const struct TransportIdentity* known = TransportState_Identity(st, shipId);
+        if (known->Hull == 0) {
+            allKnown = False;
+        } else if (s->Ships.Exists[shipId]) {
+            struct TransportIdentity now;
+            GetShipIdentity(s, shipId, &now);
+            if (now.Hull != known->Hull || now.Owner != known->Owner || now.NameHash != known->NameHash) {
+                Info("\t(!) Ship %d: was rebuilt, reset cargo", shipId);
+                if (TransportShip_HasComponents(TransportState_Find(st, shipId))) {
+                    ReportDiscarded(s, st, shipId, known->Owner);
+                }
+                TransportShip_Clear(TransportState_Ship(st, shipId));
+                TransportState_Sync(st, shipId);
+            }
+        }
+    }
+    return allKnown;
+}
+
+static void RecordShipIdentities(const struct Snapshot* s, struct TransportState* st)
+{
+    for (Uns16 shipId = TransportState_Next(st, 0); shipId != 0; shipId = TransportState_Next(st, shipId)) {
+        if (s->Ships.Exists[shipId]) {
+            GetShipIdentity(s, shipId, TransportState_Identity(st, shipId));
+        }
+    }
+}
+
+/* Reset a ship mentioned in a "ship built" record. UtilFile_Handler for HandleNewShips(). */
+static void HandleShipBuilt(void* context, const struct UtilRecord* rec)
+{
+    struct TransportState* st = context;
+    struct UtilShipBuilt sb;
+    if (UtilRecord_GetShipBuilt(rec, &sb) && TransportShip_HasComponents(TransportState_Find(st, sb.ShipId))) {
+        Info("\t(!) Ship %d: was rebuilt, reset cargo", sb.ShipId);
+        TransportShip_Clear(TransportState_Ship(st, sb.ShipId));
+        TransportState_Sync(st, sb.ShipId);
+    }
+}
+
+static void HandleNewShips(struct TransportState* st)
+{
+    /*
+     *  Cross-check for CheckShipIdentities(), for ships rebuilt with same hull, owner and name.
+     *  Scan UTIL.TMP for "ship built" records, and reset all ships seen.
+     *  This reads the whole file, and is therefore optional (ScanUtilForNewShips).
      *
      *  An alternative approach would be to hook into a pcontrol
      *  stage shortly after combat, which requires extra setup for hosts.
      */
+    struct UtilFileScan sc;
+    UtilFileScan_Init(&sc);
+    UtilFileScan_Add(&sc, UTIL_SHIP_BUILT, HandleShipBuilt, st);
 
-    // Open file
-    FILE* fp = OpenInputFile("util.tmp", GAME_DIR_ONLY | NO_MISSING_ERROR);
-    if (fp == NULL) {
+    struct UtilFile uf;
+    if (!UtilFile_Open(&uf, "util.tmp")) {
         Warning("Unable to open util.tmp; newly-built ships will not be cleaned.");
         return;
     }
-
-    // File format definitions
-    enum { PlayerSlot, TypeSlot, SizeSlot, HEADER_SIZE };
-    Uns16 header[HEADER_SIZE];
-
-    const Uns16 Type_ShipBuilt = 20;
-
-    enum { ShipSlot, BaseSlot, BODY_SIZE };
-    Uns16 body[BODY_SIZE];
-
-    // Read file
-    while (DOSRead16(header, HEADER_SIZE, fp)) {
-        if (header[TypeSlot] == Type_ShipBuilt && header[SizeSlot] >= sizeof(body)) {
-            // Found an applicable record; read it
-            if (!DOSRead16(body, BODY_SIZE, fp)) {
-                Warning("Unable to read util.tmp; aborting mid-way.");
-                break;
-            }
-
-            // Reset the mentioned ship
-            const Uns16 shipId = body[ShipSlot];
-            struct TransportShip* sh = TransportState_Ship(st, shipId);
-            if (TransportShip_HasComponents(sh)) {
-                Info("\t(!) Ship %d: was rebuilt, reset cargo", shipId);
-                TransportShip_Clear(sh);
-            }
-
-            // Skip fewer bytes
-            header[SizeSlot] -= sizeof(body);
-        }
-
-        // Skip record content
-        fseek(fp, header[SizeSlot], SEEK_CUR);
+    if (!UtilFileScan_Run(&sc, &uf)) {
+        Warning("Unable to read util.tmp; aborting mid-way.");
     }
-    fclose(fp);
+    UtilFile_Close(&uf);
 }
 
 static void RegisterTransportFCodes(const struct Config* c)
 {
-    DefineSpecialFCode("UAP");
-    DefineSpecialFCodeSeries("UE", ENGINE_NR);
-    DefineSpecialFCodeSeries("UB", BEAM_NR);
-    DefineSpecialFCodeSeries("UT", TORP_NR);
+    FCode_DefineSpecial(FC_UnloadAll);
+    FCode_DefineSpecial(FC_UnloadEngine);
+    FCode_DefineSpecial(FC_UnloadBeam);
+    FCode_DefineSpecial(FC_UnloadLauncher);
 
     if (c->TransportComp) {
-        DefineSpecialFCodeSeries("GE", ENGINE_NR);
-        DefineSpecialFCodeSeries("GB", BEAM_NR);
-        DefineSpecialFCodeSeries("GT", TORP_NR);
+        FCode_DefineSpecial(FC_GetEngine);
+        FCode_DefineSpecial(FC_GetBeam);
+        FCode_DefineSpecial(FC_GetLauncher);
     }
 }
 
@@ -746,95 +1596,168 @@ static void RegisterTransportFCodes(const struct Config* c)
  *  Public Entry Points
  */
 
-void DoTrimCargo(const struct Config* c)
+void DoTrimCargo(struct Snapshot* s, const struct Config* c)
 {
     struct TransportState st;
 
     Info("    Trimming cargo...");
-    TransportState_Load(&st);
-    TrimCargo(&st, c);
-    TransportState_Save(&st);
+    TransportState_Load(&st, TP_BeforeMovement);
+    if (!TransportState_IsEmpty(&st)) {
+        TrimCargo(s, &st);
+        TransportState_Save(&st, c);
+    }
+    TransportState_Free(&st);
+}
+
+static void LoadComponents(struct Snapshot* s, struct TransportState* st, const struct Config* c)
+{
+    /*
+     *  Loading is processed per base, so that the base's storage and build order
+     *  are evaluated once for all ships loading there.
+     *  Ships at one base are processed by ascending Id; different bases do not interact.
+     */
+
+    // Collect requests: loading only works at own bases.
+    Uns16 shipIds[SHIP_NR], planetIds[SHIP_NR], sorted[SHIP_NR];
+    Uns16 fill[PLANET_NR+2];
+    Uns16 numRequests = 0;
+    memset(fill, 0, sizeof(fill));
+
+    const struct ScheduleList loading = Schedule_Get(&s->Schedule, SS_Load);
+    for (Uns16 n = 0; n < loading.Count; ++n) {
+        const Uns16 shipId = loading.Ids[n];
+        Uns16 planetId;
+        if (TransportState_Ship(st, shipId) != NULL
+            && (planetId = Snapshot_ShipBase(s, shipId)) != 0
+            && s->Ships.Owner[shipId] == s->Planets.Owner[planetId])
+        {
+            shipIds[numRequests] = shipId;
+            planetIds[numRequests] = planetId;
+            ++fill[planetId+1];
+            ++numRequests;
+        }
+    }
+
+    // Group by base, keeping ship order
+    for (Uns16 i = 1; i <= PLANET_NR; ++i) {
+        fill[i+1] += fill[i];
+    }
+    for (Uns16 n = 0; n < numRequests; ++n) {
+        sorted[fill[planetIds[n]]++] = n;
+    }
+
+    // Process
+    struct BaseSurplus bs;
+    Uns16 currentPlanet = 0;
+    for (Uns16 n = 0; n < numRequests; ++n) {
+        const Uns16 shipId = shipIds[sorted[n]];
+        const Uns16 planetId = planetIds[sorted[n]];
+        if (planetId != currentPlanet) {
+            InitBaseSurplus(&bs, s, planetId);
+            currentPlanet = planetId;
+        }
+
+        struct TransportShip* sh = TransportState_Ship(st, shipId);
+        const int slot = s->Ships.ActionArg[shipId];
+        switch (s->Ships.Action[shipId]) {
+         case FC_GetEngine:
+            GetComponent(s, st, &bs, sh, c, shipId, planetId, ENGINE_TECH, slot);
+            break;
+         case FC_GetBeam:
+            GetComponent(s, st, &bs, sh, c, shipId, planetId, BEAM_TECH, slot);
+            break;
+         case FC_GetLauncher:
+            GetComponent(s, st, &bs, sh, c, shipId, planetId, TORP_TECH, slot);
+            break;
+         default:
+            break;
+        }
+        TransportState_Sync(st, shipId);
+    }
 }
 
-void DoComponentTransport(const struct Config* c)
+void DoComponentTransport(struct Snapshot* s, const struct Config* c)
 {
     struct TransportState st;
 
     Info("    Component transports...");
 
     // Load state
-    TransportState_Load(&st);
+    TransportState_Load(&st, TP_AfterMovement);
+    st.Remind = (c->TransportReportInterval != 0 && Turn() % c->TransportReportInterval == 0);
 
-    // Untag all ships to to avoid players doing fun things
+    // Names keep their tag until UpdateShipTags(); messages show them without it
     if (c->TagSpecialTransport) {
-        UntagShips();
+        Message_SetHiddenShipPrefix(NAME_PREFIX);
     }
 
-    // Scan for newly-built ships and remove their components
-    HandleNewShips(&st);
+    // Detect newly-built ships and remove their components
+    if (!TransportState_IsEmpty(&st)) {
+        // Identities are unknown for state files from older versions; fall back to util.tmp.
+        const Boolean allKnown = CheckShipIdentities(s, &st);
+        if (c->ScanUtilForNewShips || !allKnown) {
+            HandleNewShips(&st);
+        }
+    }
 
     // Trim overloaded ships
-    TrimCargo(&st, c);
+    if (!TransportState_IsEmpty(&st)) {
+        TrimCargo(s, &st);
+    }
 
     // Unload all ships
-    for (Uns16 shipId = 1; shipId <= SHIP_NR; ++shipId) {
-        int slot;
+    const struct ScheduleList unloading = Schedule_Get(&s->Schedule, SS_Unload);
+    for (Uns16 n = 0; n < unloading.Count; ++n) {
+        const Uns16 shipId = unloading.Ids[n];
         Uns16 planetId;
         struct TransportShip* sh;
-        if (IsShipExist(shipId)
-            && (sh = TransportState_Ship(&st, shipId))
-            && (planetId = FindPlanetAtShip(shipId)) != 0
-            && IsBaseExist(planetId))
+        if ((sh = TransportState_Ship(&st, shipId))
+            && (planetId = Snapshot_ShipBase(s, shipId)) != 0)
         {
             // Unloading works at any base and regardless of configuration.
             // Players need to be able to get rid of components after transport has been turned off.
             // Players can gift components to others.
-            if (ShipHasFCode(shipId, "UAP")) {
-                UnloadAll(sh, shipId, planetId);
-            } else if ((slot = ShipMatchFCode(shipId, "UE", ENGINE_NR)) != 0) {
-                UnloadComponent(sh, shipId, planetId, ENGINE_TECH, slot);
-            } else if ((slot = ShipMatchFCode(shipId, "UB", BEAM_NR)) != 0) {
-                UnloadComponent(sh, shipId, planetId, BEAM_TECH, slot);
-            } else if ((slot = ShipMatchFCode(shipId, "UT", TORP_NR)) != 0) {
-                UnloadComponent(sh, shipId, planetId, TORP_TECH, slot);
+            const int slot = s->Ships.ActionArg[shipId];
+            switch (s->Ships.Action[shipId]) {
+             case FC_UnloadAll:
+                UnloadAll(s, &st, sh, shipId, planetId);
+                break;
+             case FC_UnloadEngine:
+                UnloadComponent(s, &st, sh, shipId, planetId, ENGINE_TECH, slot);
+                break;
+             case FC_UnloadBeam:
+                UnloadComponent(s, &st, sh, shipId, planetId, BEAM_TECH, slot);
+                break;
+             case FC_UnloadLauncher:
+                UnloadComponent(s, &st, sh, shipId, planetId, TORP_TECH, slot);
+                break;
+             default:
+                break;
             }
+            TransportState_Sync(&st, shipId);
         }
     }
 
     // Load all ships
     if (c->TransportComp) {
-        for (Uns16 shipId = 1; shipId <= SHIP_NR; ++shipId) {
-            int slot;
-            Uns16 planetId;
-            struct TransportShip* sh;
-            if (IsShipExist(shipId)
-                && (sh = TransportState_Ship(&st, shipId))
-                && (planetId = FindPlanetAtShip(shipId)) != 0
-                && IsBaseExist(planetId)
-                && ShipOwner(shipId) == PlanetOwner(planetId))
-            {
-                // Loading only works at own bases, and only when configured.
-                if ((slot = ShipMatchFCode(shipId, "GE", ENGINE_NR)) != 0) {
-                    GetComponent(sh, c, shipId, planetId, ENGINE_TECH, slot);
-                } else if ((slot = ShipMatchFCode(shipId, "GB", BEAM_NR)) != 0) {
-                    GetComponent(sh, c, shipId, planetId, BEAM_TECH, slot);
-                } else if ((slot = ShipMatchFCode(shipId, "GT", TORP_NR)) != 0) {
-                    GetComponent(sh, c, shipId, planetId, TORP_TECH, slot);
-                }
-            }
-        }
+        LoadComponents(s, &st, c);
     }
 
     // Send all reports
-    ReportShips(&st, c);
+    ReportShips(s, &st, c);
 
-    // Tag all ships that carry components
+    // Tag exactly the ships that carry components
     if (c->TagSpecialTransport) {
-        TagShips(&st);
+        Message_SetHiddenShipPrefix(NULL);
+        UpdateShipTags(s, &st);
     }
 
+    // Remember identities (including final names) to detect rebuilt ships next turn
+    RecordShipIdentities(s, &st);
+
     // Save state
-    TransportState_Save(&st);
+    TransportState_Save(&st, c);
+    TransportState_Free(&st);
 
     // Friendly codes
     RegisterTransportFCodes(c);
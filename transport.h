@@ -8,45 +8,128 @@
 #include <phostpdk.h>
 
 struct Config;
+struct Snapshot;
+
+/** Prefix for names of ships that carry components. */
+#define TRANSPORT_NAME_PREFIX "ST: "
 
 /*
  *  Classes
  */
 
+/** Component slots.
+    All component counts of a ship are stored in a single array, so that
+    operations on all of them are simple loops over contiguous memory.
+    This order is also used in the state file. */
+enum TransportSlot {
+    TRANSPORT_BEAM_SLOT     = 0,                          /**< First beam slot. */
+    TRANSPORT_LAUNCHER_SLOT = BEAM_NR,                    /**< First torpedo launcher slot. */
+    TRANSPORT_ENGINE_SLOT   = BEAM_NR + TORP_NR,          /**< First engine slot. */
+    TRANSPORT_SLOT_NR       = BEAM_NR + TORP_NR + ENGINE_NR
+};
+
 /** State for a single ship. */
 struct TransportShip {
-    Uns16 Engines[ENGINE_NR];     /**< Loaded engines. Indexed by Id-1. */
-    Uns16 Beams[BEAM_NR];         /**< Loaded beams. Indexed by Id-1. */
-    Uns16 Launchers[TORP_NR];     /**< Loaded torpedo launchers. Indexed by Id-1. */
+    Uns16 Slots[TRANSPORT_SLOT_NR];   /**< Loaded components. Indexed by enum TransportSlot + Id-1. */
+};
+
+/** Processing phase that loads and saves the state. */
+enum TransportPhase {
+    TP_None,                    /**< Read-only access; unknown. */
+    TP_BeforeMovement,          /**< Cargo trimming (auxhost1). */
+    TP_AfterMovement            /**< Component transport (auxhost2). */
 };
 
-/** State for all ships. */
+/** Identification of a saved state. */
+struct TransportStamp {
+    Uns16 Turn;                 /**< Turn number of run that produced the state; 0 if unknown. */
+    Uns16 Phase;                /**< Phase (enum TransportPhase) of run that produced the state; TP_None if unknown. */
+    Uns32 Generation;           /**< Sequence number, unique for each saved state; 0 if unknown. */
+};
+
+/** Identity of a ship, to detect reuse of its Id. */
+struct TransportIdentity {
+    Uns16 Hull;                 /**< Hull number; 0 if unknown. */
+    Uns16 Owner;                /**< Owner. */
+    Uns32 NameHash;             /**< CRC-32C of ship name. */
+};
+
+/** State for all ships.
+    Only ships that have (had) cargo have a record.
+    Carriers has a bit set for each ship that currently carries components. */
 struct TransportState {
-    struct TransportShip Ships[SHIP_NR];   /**< For each ship, its carried cargo. Indexed by Id-1. */
+    Uns16 Index[SHIP_NR];                           /**< For each ship, 1 + index into Records; 0 if none. Indexed by Id-1. */
+    struct TransportShip* Records;                  /**< Ship records. */
+    Uns32* TrimFingerprints;                        /**< For each record, fingerprint of the ship after its last trim; 0 if none. */
+    struct TransportIdentity* Identities;           /**< For each record, identity of the ship at the end of the last transport phase. */
+    Uns16 NumRecords;                               /**< Number of used elements in Records. */
+    Uns16 RecordCapacity;                           /**< Number of allocated elements in Records. */
+    Uns32 Carriers[(SHIP_NR + 31) / 32];            /**< Ships carrying components. Bit (Id-1)%32 of word (Id-1)/32. */
+    struct TransportStamp Stamp;                    /**< Identification of loaded state (after rollback). */
+    Uns8 RunPhase;                                  /**< Phase (enum TransportPhase) this state was loaded for. */
+    struct TransportShip* Baseline;                 /**< Copy of Records as loaded, to determine changes. */
+    Uns16 NumBaseline;                              /**< Number of elements in Baseline. */
+    Uns32 ReportDigests[SHIP_NR];                   /**< For each ship, digest of the last cargo report sent; 0 if none. Indexed by Id-1. */
+    Uns32 FailureDigests[SHIP_NR];                  /**< For each ship, digest of the last failure message sent; 0 if none. Indexed by Id-1. */
+    Uns32 FailuresSeen[(SHIP_NR + 31) / 32];        /**< Ships that had a failure in this run. Bit (Id-1)%32 of word (Id-1)/32. */
+    Boolean Remind;                                 /**< True to send all messages, even if unchanged. */
 };
 
 /** Load state.
     If state file does not exist, state is initialized to empty.
-    @param [out] st State
-    @pre PDK initialized (gGameDirectory set) */
-void TransportState_Load(struct TransportState* st);
+    If the state file has been produced by the same or a later phase of the current turn
+    (i.e. the turn is being re-run), it is rolled back using the history file.
+    @param [out] st    State; must be released using TransportState_Free()
+    @param [in]  phase Phase; TP_None for read-only access without rollback
+    @pre PDK initialized (gGameDirectory set); for phase other than TP_None, host data loaded */
+void TransportState_Load(struct TransportState* st, enum TransportPhase phase);
 
 /** Save state.
-    @param [in] st State
-    @pre PDK initialized (gGameDirectory set) */
-void TransportState_Save(struct TransportState* st);
+    Stages the new state file (see StateFile_Stage()) and records the changes in the history file.
+    @param [in] st State; must have been loaded with a phase other than TP_None
+    @param [in] c  Configuration
+    @pre PDK initialized (gGameDirectory set), host data loaded */
+void TransportState_Save(struct TransportState* st, const struct Config* c);
+
+/** Release state.
+    @param [in,out] st State */
+void TransportState_Free(struct TransportState* st);
 
-/** Access state for one ship.
+/** Access state for one ship, creating it if needed.
+    The returned pointer is valid until the next call that creates a ship record.
     @param [in] st     State
     @param [in] shipId Ship Id
     @return Ship state; NULL if st is NULL or shipId is out of range. The return value can therefore also serve as a range check. */
 struct TransportShip* TransportState_Ship(struct TransportState* st, Uns16 shipId);
 
+/** Find state for one ship.
+    @param [in] st     State
+    @param [in] shipId Ship Id
+    @return Ship state; NULL if ship has no record or shipId is out of range */
+const struct TransportShip* TransportState_Find(const struct TransportState* st, Uns16 shipId);
+
+/** Find next ship carrying components.
+    @param [in] st     State
+    @param [in] shipId Start after this ship Id (0 to start at the beginning)
+    @return Ship Id; 0 if there is no further carrier */
+Uns16 TransportState_Next(const struct TransportState* st, Uns16 shipId);
+
+/** Check for carriers.
+    @param [in] st     State
+    @return True if no ship carries any component */
+Boolean TransportState_IsEmpty(const struct TransportState* st);
+
 /** Check for components on ship.
     @param [in] sh Ship state
     @return True if ship carries any component */
 Boolean TransportShip_HasComponents(const struct TransportShip* sh);
 
+/** Get slot index for a component.
+    @param [in] type Component type (ENGINE_TECH, BEAM_TECH, TORP_TECH)
+    @param [in] slot Component slot (1-based)
+    @return Index into TransportShip::Slots; TRANSPORT_SLOT_NR if parameters are invalid or out of range */
+int TransportShip_SlotIndex(BaseTech_Def type, Uns16 slot);
+
 /** Get components on ship.
     @param [in] sh   Ship state
     @param [in] type Component type (ENGINE_TECH, BEAM_TECH, TORP_TECH)
@@ -62,13 +145,15 @@ Uns16 TransportShip_Cargo(const struct TransportShip* sh, BaseTech_Def type, Uns
 /** Cargo trimming.
     This will load state, perform cargo trimming, and save again.
     For use during auxhost1.
-    @param [in] c Configuration */
-void DoTrimCargo(const struct Config* c);
+    @param [in,out] s Game snapshot
+    @param [in]     c Configuration */
+void DoTrimCargo(struct Snapshot* s, const struct Config* c);
 
 /** Component transport stage.
     This will load state, perform all actions (including cargo trimming), and save again.
     For use during auxhost2.
-    @param [in] c Configuration */
-void DoComponentTransport(const struct Config* c);
+    @param [in,out] s Game snapshot
+    @param [in]     c Configuration */
+void DoComponentTransport(struct Snapshot* s, const struct Config* c);
 
 #endif
@@ -0,0 +1,117 @@
+/**
+  *  \file trim.c
+  *  \brief Starbase Reloaded - Cargo Trimming
+  */
+
+#include "trim.h"
+#include "util.h"
+
+/* Find first nonempty slot in range [first, end); -1 if none. */
+static int FindLoadedSlot(const struct TransportShip* sh, int first, int end)
+{
+    while (first < end && sh->Slots[first] == 0) {
+        ++first;
+    }
+    return first < end ? first : -1;
+}
+
+Uns16 Trim_Components(struct TransportShip* sh, const struct Profiles* p, Uns32* pMass, Uns32 maxMass)
+{
+    // As long as no slot runs empty, each round drops the same mass, so instead of dropping
+    // components one by one, we compute the number of full rounds for each such stretch.
+    // A stretch ends when a slot runs empty, so this takes at most one step per slot.
+    //
+    // Types in the order they are dropped in each round.
+    static const struct {
+        int First;
+        int Count;
+    } TYPES[] = {
+        { TRANSPORT_BEAM_SLOT,     BEAM_NR },
+        { TRANSPORT_LAUNCHER_SLOT, TORP_NR },
+        { TRANSPORT_ENGINE_SLOT,   ENGINE_NR },
+    };
+    enum { NUM_TYPES = sizeof(TYPES)/sizeof(TYPES[0]) };
+
+    if (*pMass <= maxMass) {
+        return 0;
+    }
+
+    int current[NUM_TYPES];
+    for (int t = 0; t < NUM_TYPES; ++t) {
+        current[t] = FindLoadedSlot(sh, TYPES[t].First, TYPES[t].First + TYPES[t].Count);
+    }
+
+    const Uns32 excess = *pMass - maxMass;
+    Uns32 dropped = 0;
+    Uns16 count = 0;
+    while (dropped < excess) {
+        // Determine stretch: mass dropped per round, number of rounds until a slot runs empty
+        Uns32 rate = 0;
+        Uns16 rounds = 0xFFFF;
+        for (int t = 0; t < NUM_TYPES; ++t) {
+            if (current[t] >= 0) {
+                rate += p->ComponentMass[current[t]];
+                rounds = MIN(rounds, sh->Slots[current[t]]);
+            }
+        }
+        if (rate == 0) {
+            // Unable to trim more
+            break;
+        }
+
+        const Uns32 needed = (excess - dropped - 1) / rate + 1;
+        if (needed <= rounds) {
+            // Finish within this stretch: full rounds, then a partial round
+            for (int t = 0; t < NUM_TYPES; ++t) {
+                if (current[t] >= 0) {
+                    sh->Slots[current[t]] -= needed-1;
+                    count += needed-1;
+                }
+            }
+            dropped += (needed-1) * rate;
+            for (int t = 0; t < NUM_TYPES && dropped < excess; ++t) {
+                if (current[t] >= 0) {
+                    --sh->Slots[current[t]];
+                    ++count;
+                    dropped += p->ComponentMass[current[t]];
+                }
+            }
+        } else {
+            // Complete this stretch
+            for (int t = 0; t < NUM_TYPES; ++t) {
+                if (current[t] >= 0) {
+                    sh->Slots[current[t]] -= rounds;
+                    count += rounds;
+                    if (sh->Slots[current[t]] == 0) {
+                        current[t] = FindLoadedSlot(sh, current[t] + 1, TYPES[t].First + TYPES[t].Count);
+                    }
+                }
+            }
+            dropped += (Uns32) rounds * rate;
+        }
+    }
+
+    *pMass -= MIN(dropped, *pMass);
+    return count;
+}
+
+void Trim_RegularCargo(Uns16 cargo[SHIP_CARGO_NR], Uns16 toDrop)
+{
+    // A round at least removes a sixth of the excess or empties all remaining types,
+    // so this needs only a few dozen rounds even for a full 16-bit excess.
+    while (toDrop > 0) {
+        const Uns16 share = MAX(toDrop / SHIP_CARGO_NR, 1);
+        Boolean ok = False;
+        for (int i = 0; i < SHIP_CARGO_NR; ++i) {
+            const Uns16 drop = MIN(cargo[i], MIN(toDrop, share));
+            if (drop != 0) {
+                cargo[i] -= drop;
+                toDrop -= drop;
+                ok = True;
+            }
+        }
+        if (!ok) {
+            break;
+        }
+    }
+}
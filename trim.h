@@ -0,0 +1,34 @@
+/**
+  *  \file trim.h
+  *  \brief Starbase Reloaded - Cargo Trimming
+  *
+  *  Computes what to drop from an overloaded component carrier.
+  *  These functions work on plain data only; the caller applies the result
+  *  to the ship and reports it.
+  */
+#ifndef TRIM_H_INCLUDED
+#define TRIM_H_INCLUDED
+
+#include <phostpdk.h>
+#include "profile.h"
+#include "snapshot.h"
+#include "transport.h"
+
+/** Drop components until their mass does not exceed a limit (pass 1).
+    Components are dropped in rounds: one beam, one launcher, one engine,
+    each from the lowest nonempty slot, stopping as soon as the mass fits.
+    @param [in,out] sh      Ship's components
+    @param [in]     p       Profiles (for component masses)
+    @param [in,out] pMass   Component mass; updated
+    @param [in]     maxMass Maximum component mass
+    @return Number of dropped components */
+Uns16 Trim_Components(struct TransportShip* sh, const struct Profiles* p, Uns32* pMass, Uns32 maxMass);
+
+/** Drop regular cargo (pass 2).
+    Cargo is removed from all types in equal amounts, in rounds. Each round removes up to
+    a sixth of the remaining excess from each type (at least 1), in enum ShipCargo order.
+    @param [in,out] cargo  Ship's cargo, indexed by enum ShipCargo
+    @param [in]     toDrop Amount to drop (kt) */
+void Trim_RegularCargo(Uns16 cargo[SHIP_CARGO_NR], Uns16 toDrop);
+
+#endif
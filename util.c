@@ -6,68 +6,61 @@
 #include <string.h>
 #include "util.h"
 
-static int MatchFCode(const char* fc, const char* prefix, int limit)
+Boolean AnyNonzero(const Uns16* array, size_t count)
 {
-    if (memcmp(fc, prefix, 2) == 0) {
-        if (fc[2] == '0' && limit >= 10) {
-            return 10;
-        }
-        if (fc[2] >= '1' && fc[2] <= '0' + limit) {
-            return fc[2] - '0';
-        }
+    // No early exit; this is used on short arrays, and compilers vectorize this form.
+    Uns16 acc = 0;
+    for (size_t i = 0; i < count; ++i) {
+        acc |= array[i];
     }
-    return 0;
-}
-
-Boolean PlanetHasFCode(Uns16 planetId, const char* expected)
-{
-    char fc[3];
-    PlanetFCode(planetId, fc);
-    return memcmp(fc, expected, 3) == 0;
+    return acc != 0;
 }
 
-int PlanetMatchFCode(Uns16 planetId, const char* prefix, int limit)
-{
-    char fc[3];
-    PlanetFCode(planetId, fc);
-    return MatchFCode(fc, prefix, limit);
-}
-
-Boolean ShipHasFCode(Uns16 shipId, const char* expected)
+Uns16 EffTrueHull(RaceType_Def player, Uns16 index)
 {
-    char fc[3];
-    ShipFCode(shipId, fc);
-    return memcmp(fc, expected, 3) == 0;
+    return gPconfigInfo->MapTruehullByPlayerRace
+        ? TrueHull(EffRace(player), index)
+        : TrueHull(player, index);
 }
 
-int ShipMatchFCode(Uns16 shipId, const char* prefix, int limit)
+static Uns32 AxisDistance(Uns16 a, Uns16 b, int axis)
 {
-    char fc[3];
-    ShipFCode(shipId, fc);
-    return MatchFCode(fc, prefix, limit);
+    Uns32 d = (a > b ? a - b : b - a);
+    if (gPconfigInfo->AllowWraparoundMap) {
+        const Uns32 size = gPconfigInfo->WraparoundRectangle[axis+2] - gPconfigInfo->WraparoundRectangle[axis];
+        if (d > size/2 && d <= size) {
+            d = size - d;
+        }
+    }
+    return d;
 }
 
-void DefineSpecialFCodeSeries(const char* prefix, int limit)
+Uns32 MapDistanceSquared(Uns16 x1, Uns16 y1, Uns16 x2, Uns16 y2)
 {
-    for (int i = 1; i <= limit; ++i) {
-        char fc[] = { prefix[0], prefix[1], '0' + (i%10), '\0' };
-        DefineSpecialFCode(fc);
-    }
+    const Uns32 dx = AxisDistance(x1, x2, 0);
+    const Uns32 dy = AxisDistance(y1, y2, 1);
+    return dx*dx + dy*dy;
 }
 
-Boolean AnyNonzero(const Uns16* array, size_t count)
+Uns32 Crc32c(Uns32 crc, const void* data, size_t size)
 {
-    for (size_t i = 0; i < count; ++i) {
-        if (array[i] != 0) {
-            return True;
+    static Uns32 table[256];
+    static Boolean tableValid = False;
+    if (!tableValid) {
+        for (Uns32 i = 0; i < 256; ++i) {
+            Uns32 value = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                value = (value & 1) ? (value >> 1) ^ 0x82F63B78 : (value >> 1);
+            }
+            table[i] = value;
         }
+        tableValid = True;
     }
-    return False;
-}
 
-Uns16 EffTrueHull(RaceType_Def player, Uns16 index)
-{
-    return gPconfigInfo->MapTruehullByPlayerRace
-        ? TrueHull(EffRace(player), index)
-        : TrueHull(player, index);
+    const Uns8* p = data;
+    crc = ~crc;
+    while (size-- > 0) {
+        crc = table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
 }
@@ -4,18 +4,14 @@
   */
 
 #include "utildata.h"
+#include "hostdata.h"
 
 #define DIM(x) (sizeof(x)/sizeof(x[0]))
 
-/* Minefield update.
+/* Minefield update (UTIL_MINE_UPDATE).
    We re-use PHost's regular minefield update.
    We use the extended edition in an attempt to not confuse very old programs
    which may have stricter requirements on records. */
-static const Uns16 RECORD_MINE_UPDATE = 46;
-
-/* Special transport reports (custom records). */
-static const Uns16 RECORD_TRANSPORT_SUMMARY = 0x4080;
-static const Uns16 RECORD_TRANSPORT_COMPONENT = 0x4081;
 
 
 void Util_Transport_Summary(RaceType_Def to, Uns16 shipId, Uns16 totalCargo)
@@ -25,18 +21,26 @@ void Util_Transport_Summary(RaceType_Def to, Uns16 shipId, Uns16 totalCargo)
         totalCargo
     };
     WordSwapShort(data, DIM(data));
-    PutUtilRecordSimple(to, RECORD_TRANSPORT_SUMMARY, sizeof(data), &data);
+    HostData_PutUtilRecord(to, UTIL_TRANSPORT_SUMMARY, sizeof(data), &data);
+}
+
+/* Convert internal component type (BaseTech_Def) into external type; 0 if invalid. */
+static Uns16 ExternalComponentType(BaseTech_Def type)
+{
+    switch (type) {
+     case ENGINE_TECH:  return 1;
+     case BEAM_TECH:    return 2;
+     case TORP_TECH:    return 3;
+     default:           return 0;
+    }
 }
 
 void Util_Transport_Component(RaceType_Def to, Uns16 shipId, BaseTech_Def type, Uns16 slot, Uns16 numComponents, Uns16 componentMass)
 {
     // Convert internal type (BaseTech_Def) into external type.
-    Uns16 externalType;
-    switch (type) {
-     case ENGINE_TECH:  externalType = 1; break;
-     case BEAM_TECH:    externalType = 2; break;
-     case TORP_TECH:    externalType = 3; break;
-     default: return;
+    const Uns16 externalType = ExternalComponentType(type);
+    if (externalType == 0) {
+        return;
     }
 
     // Write record
@@ -48,7 +52,74 @@ void Util_Transport_Component(RaceType_Def to, Uns16 shipId, BaseTech_Def type,
         componentMass
     };
     WordSwapShort(data, DIM(data));
-    PutUtilRecordSimple(to, RECORD_TRANSPORT_COMPONENT, sizeof(data), &data);
+    HostData_PutUtilRecord(to, UTIL_TRANSPORT_COMPONENT, sizeof(data), &data);
+}
+
+/* Transport manifest (UTIL_TRANSPORT_MANIFEST).
+   Layout: ship count, then for each ship: Id, total mass, component count,
+   and for each component: type, slot, count, mass. */
+enum {
+    MANIFEST_HEADER_WORDS = 1,
+    MANIFEST_SHIP_WORDS = 3,
+    MANIFEST_COMPONENT_WORDS = 4,
+    MANIFEST_MAX_SHIP_WORDS = MANIFEST_SHIP_WORDS + MANIFEST_COMPONENT_WORDS * (ENGINE_NR + BEAM_NR + TORP_NR)
+};
+
+static void FlushManifest(struct UtilTransportManifest* m)
+{
+    if (m->Data[0] != 0) {
+        WordSwapShort(m->Data, m->Length);
+        HostData_PutUtilRecord(m->To, m->Type, 2*m->Length, m->Data);
+    }
+    m->Data[0] = 0;
+    m->Length = MANIFEST_HEADER_WORDS;
+    m->ShipStart = 0;
+}
+
+void Util_TransportManifest_Init(struct UtilTransportManifest* m, RaceType_Def to)
+{
+    m->To = to;
+    m->Type = UTIL_TRANSPORT_MANIFEST;
+    m->Data[0] = 0;
+    m->Length = MANIFEST_HEADER_WORDS;
+    m->ShipStart = 0;
+}
+
+void Util_TransportDiscarded_Init(struct UtilTransportManifest* m, RaceType_Def to)
+{
+    Util_TransportManifest_Init(m, to);
+    m->Type = UTIL_TRANSPORT_DISCARDED;
+}
+
+void Util_TransportManifest_AddShip(struct UtilTransportManifest* m, Uns16 shipId, Uns16 totalCargo)
+{
+    // Start a new record unless the ship fits with all possible components
+    if (m->Length + MANIFEST_MAX_SHIP_WORDS > UTIL_MANIFEST_MAX_WORDS) {
+        FlushManifest(m);
+    }
+    m->ShipStart = m->Length;
+    m->Data[m->Length++] = shipId;
+    m->Data[m->Length++] = totalCargo;
+    m->Data[m->Length++] = 0;
+    ++m->Data[0];
+}
+
+void Util_TransportManifest_AddComponent(struct UtilTransportManifest* m, BaseTech_Def type, Uns16 slot, Uns16 numComponents, Uns16 componentMass)
+{
+    const Uns16 externalType = ExternalComponentType(type);
+    if (externalType == 0 || m->ShipStart == 0 || m->Length + MANIFEST_COMPONENT_WORDS > UTIL_MANIFEST_MAX_WORDS) {
+        return;
+    }
+    m->Data[m->Length++] = externalType;
+    m->Data[m->Length++] = slot;
+    m->Data[m->Length++] = numComponents;
+    m->Data[m->Length++] = componentMass;
+    ++m->Data[m->ShipStart + 2];
+}
+
+void Util_TransportManifest_Finish(struct UtilTransportManifest* m)
+{
+    FlushManifest(m);
 }
 
 void Util_Minefield(RaceType_Def to, Uns16 mineId, Uns16 x, Uns16 y, Uns16 owner, Uns32 units, Uns16 type, enum MineReason scanReason)
@@ -66,5 +137,5 @@ void Util_Minefield(RaceType_Def to, Uns16 mineId, Uns16 x, Uns16 y, Uns16 owner
     };
 
     WordSwapShort(data, DIM(data));
-    PutUtilRecordSimple(to, RECORD_MINE_UPDATE, sizeof(data), &data);
+    HostData_PutUtilRecord(to, UTIL_MINE_UPDATE, sizeof(data), &data);
 }
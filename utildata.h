@@ -7,6 +7,30 @@
 
 #include <phostpdk.h>
 
+/** Record types. */
+enum UtilRecordType {
+    UTIL_SHIP_BUILT = 20,                   /**< Ship built (PHost). */
+    UTIL_MINE_UPDATE = 46,                  /**< Minefield, extended version (PHost, also written by us). */
+    UTIL_TRANSPORT_SUMMARY = 0x4080,        /**< Special transport summary (custom). */
+    UTIL_TRANSPORT_COMPONENT = 0x4081,      /**< Special transport component (custom). */
+    UTIL_TRANSPORT_MANIFEST = 0x4082,       /**< Special transport manifest (custom). */
+    UTIL_TRANSPORT_DISCARDED = 0x4083       /**< Special transport parts discarded (custom). */
+};
+
+/** Maximum size of a "Transport Manifest" record, in words. */
+#define UTIL_MANIFEST_MAX_WORDS 2000
+
+/** Builder for "Transport Manifest" records.
+    Collects all special transports of one player.
+    If they do not fit into one record, multiple records are written, each containing complete ships. */
+struct UtilTransportManifest {
+    RaceType_Def To;                        /**< Receiver. */
+    Uns16 Type;                             /**< Record type (UTIL_TRANSPORT_MANIFEST or UTIL_TRANSPORT_DISCARDED). */
+    Uns16 ShipStart;                        /**< Internal: index of current ship's entry in Data. */
+    Uns16 Length;                           /**< Internal: number of words in Data. */
+    Uns16 Data[UTIL_MANIFEST_MAX_WORDS];    /**< Internal: record content (host byte order). */
+};
+
 enum MineReason {
     MINE_LAID = 0,
     MINE_SWEPT = 1,
@@ -30,6 +54,37 @@ void Util_Transport_Summary(RaceType_Def to, Uns16 shipId, Uns16 totalCargo);
     @param componentMass  Mass of each of these components */
 void Util_Transport_Component(RaceType_Def to, Uns16 shipId, BaseTech_Def type, Uns16 slot, Uns16 numComponents, Uns16 componentMass);
 
+/** Start "Transport Manifest" records.
+    @param [out] m  Builder
+    @param [in]  to Receiver */
+void Util_TransportManifest_Init(struct UtilTransportManifest* m, RaceType_Def to);
+
+/** Start "Transport Discarded" records.
+    These have the same layout as "Transport Manifest" records, and list ships whose parts were discarded
+    because the ship was renamed, captured or rebuilt. Use the Util_TransportManifest_XXX functions to fill them.
+    @param [out] m  Builder
+    @param [in]  to Receiver */
+void Util_TransportDiscarded_Init(struct UtilTransportManifest* m, RaceType_Def to);
+
+/** Add ship to "Transport Manifest" records.
+    @param [in,out] m          Builder
+    @param [in]     shipId     Ship Id
+    @param [in]     totalCargo Total cargo room blocked by starship parts */
+void Util_TransportManifest_AddShip(struct UtilTransportManifest* m, Uns16 shipId, Uns16 totalCargo);
+
+/** Add component to current ship in "Transport Manifest" records.
+    @param [in,out] m              Builder
+    @param [in]     type           Component type (beam/engine/launcher)
+    @param [in]     slot           Slot number (beam/engine/torpedo type)
+    @param [in]     numComponents  Number of components of this type
+    @param [in]     componentMass  Mass of each of these components */
+void Util_TransportManifest_AddComponent(struct UtilTransportManifest* m, BaseTech_Def type, Uns16 slot, Uns16 numComponents, Uns16 componentMass);
+
+/** Finish "Transport Manifest" records.
+    Writes the last record, if it contains any ships.
+    @param [in,out] m Builder */
+void Util_TransportManifest_Finish(struct UtilTransportManifest* m);
+
 /** Write a "Minefield" record.
     Written on every change of a minefield.
     @param to             Receiver
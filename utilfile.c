@@ -0,0 +1,149 @@
+/**
+  *  \file utilfile.c
+  *  \brief Starbase Reloaded - util.tmp Reader
+  */
+
+#include "utilfile.h"
+#include "utildata.h"
+
+/* Record header: player, type, size (Uns16 each). */
+static const size_t HEADER_SIZE = 6;
+
+/* Get little-endian 16-bit value. */
+static Uns16 GetWord(const Uns8* p, size_t index)
+{
+    return p[2*index] | (p[2*index+1] << 8);
+}
+
+/* Get little-endian 16-bit value from record, 0 if beyond end. */
+static Uns16 GetField(const struct UtilRecord* rec, size_t index)
+{
+    return 2*index + 2 <= rec->Size ? GetWord(rec->Data, index) : 0;
+}
+
+/*
+ *  Iteration
+ */
+
+Boolean UtilFile_Open(struct UtilFile* uf, const char* name)
+{
+    uf->Pos = 0;
+    uf->Truncated = False;
+    return StateFile_Open(&uf->File, name);
+}
+
+Boolean UtilFile_Next(struct UtilFile* uf, struct UtilRecord* rec)
+{
+    const size_t remaining = uf->File.Size - uf->Pos;
+    if (remaining < HEADER_SIZE) {
+        uf->Truncated = (remaining != 0);
+        return False;
+    }
+
+    const Uns8* p = uf->File.Data + uf->Pos;
+    const Uns16 size = GetWord(p, 2);
+    if (remaining - HEADER_SIZE < size) {
+        uf->Truncated = True;
+        return False;
+    }
+
+    rec->Player = GetWord(p, 0);
+    rec->Type = GetWord(p, 1);
+    rec->Size = size;
+    rec->Data = p + HEADER_SIZE;
+    uf->Pos += HEADER_SIZE + size;
+    return True;
+}
+
+void UtilFile_Close(struct UtilFile* uf)
+{
+    StateFile_Close(&uf->File);
+}
+
+/*
+ *  Consumers
+ */
+
+void UtilFileScan_Init(struct UtilFileScan* sc)
+{
+    sc->NumConsumers = 0;
+}
+
+void UtilFileScan_Add(struct UtilFileScan* sc, Uns16 type, UtilFile_Handler* handler, void* context)
+{
+    if (sc->NumConsumers >= UTILFILE_MAX_CONSUMERS) {
+        ErrorExit("Too many util.tmp consumers");
+    }
+    sc->Consumers[sc->NumConsumers].Type = type;
+    sc->Consumers[sc->NumConsumers].Handler = handler;
+    sc->Consumers[sc->NumConsumers].Context = context;
+    ++sc->NumConsumers;
+}
+
+Boolean UtilFileScan_Run(const struct UtilFileScan* sc, struct UtilFile* uf)
+{
+    struct UtilRecord rec;
+    while (UtilFile_Next(uf, &rec)) {
+        for (int i = 0; i < sc->NumConsumers; ++i) {
+            if (sc->Consumers[i].Type == rec.Type) {
+                sc->Consumers[i].Handler(sc->Consumers[i].Context, &rec);
+            }
+        }
+    }
+
+    return !uf->Truncated;
+}
+
+/*
+ *  Decoders
+ */
+
+Boolean UtilRecord_GetShipBuilt(const struct UtilRecord* rec, struct UtilShipBuilt* out)
+{
+    if (rec->Type != UTIL_SHIP_BUILT || rec->Size < 4) {
+        return False;
+    }
+    out->ShipId = GetField(rec, 0);
+    out->BaseId = GetField(rec, 1);
+    return True;
+}
+
+Boolean UtilRecord_GetMinefield(const struct UtilRecord* rec, struct UtilMinefield* out)
+{
+    // Controlling planet and reason are not present in older versions.
+    if (rec->Type != UTIL_MINE_UPDATE || rec->Size < 14) {
+        return False;
+    }
+    out->MineId   = GetField(rec, 0);
+    out->X        = GetField(rec, 1);
+    out->Y        = GetField(rec, 2);
+    out->Owner    = GetField(rec, 3);
+    out->Units    = GetField(rec, 4) | ((Uns32) GetField(rec, 5) << 16);
+    out->Type     = GetField(rec, 6);
+    out->PlanetId = GetField(rec, 7);
+    out->Reason   = GetField(rec, 8);
+    return True;
+}
+
+Boolean UtilRecord_GetTransportSummary(const struct UtilRecord* rec, struct UtilTransportSummary* out)
+{
+    if (rec->Type != UTIL_TRANSPORT_SUMMARY || rec->Size < 4) {
+        return False;
+    }
+    out->ShipId     = GetField(rec, 0);
+    out->TotalCargo = GetField(rec, 1);
+    return True;
+}
+
+Boolean UtilRecord_GetTransportComponent(const struct UtilRecord* rec, struct UtilTransportComponent* out)
+{
+    if (rec->Type != UTIL_TRANSPORT_COMPONENT || rec->Size < 10) {
+        return False;
+    }
+    out->ShipId = GetField(rec, 0);
+    out->Type   = GetField(rec, 1);
+    out->Slot   = GetField(rec, 2);
+    out->Count  = GetField(rec, 3);
+    out->Mass   = GetField(rec, 4);
+    return True;
+}
@@ -0,0 +1,140 @@
+/**
+  *  \file utilfile.h
+  *  \brief Starbase Reloaded - util.tmp Reader
+  *
+  *  Reads util.tmp through a memory mapping and returns records as views
+  *  into the file, without copying.
+  *
+  *  UtilFile_Open()/UtilFile_Next() iterate over all records.
+  *  To serve several consumers with a single pass over the file, register
+  *  them with UtilFileScan_Add(), then call UtilFileScan_Run() once.
+  */
+#ifndef UTILFILE_H_INCLUDED
+#define UTILFILE_H_INCLUDED
+
+#include <phostpdk.h>
+#include "statefile.h"
+
+/** Maximum number of consumers for a UtilFileScan. */
+#define UTILFILE_MAX_CONSUMERS 8
+
+/** Record, as a view into the file. */
+struct UtilRecord {
+    RaceType_Def Player;        /**< Receiver. */
+    Uns16        Type;          /**< Record type (enum UtilRecordType). */
+    Uns16        Size;          /**< Payload size in bytes. */
+    const Uns8*  Data;          /**< Payload. Valid until the file is closed. */
+};
+
+/** util.tmp file, opened for iteration. */
+struct UtilFile {
+    struct StateFile File;      /**< Internal: file content. */
+    size_t           Pos;       /**< Internal: position of next record. */
+    Boolean          Truncated; /**< Set if the file ends in the middle of a record. */
+};
+
+/** Record handler.
+    @param [in] context Context, as passed to UtilFileScan_Add()
+    @param [in] rec     Record */
+typedef void UtilFile_Handler(void* context, const struct UtilRecord* rec);
+
+/** Consumers for a single pass over util.tmp. */
+struct UtilFileScan {
+    struct {
+        Uns16             Type;
+        UtilFile_Handler* Handler;
+        void*             Context;
+    } Consumers[UTILFILE_MAX_CONSUMERS];
+    int NumConsumers;
+};
+
+/** Decoded "ship built" record (type 20). */
+struct UtilShipBuilt {
+    Uns16 ShipId;               /**< Ship Id. */
+    Uns16 BaseId;               /**< Starbase Id. */
+};
+
+/** Decoded "minefield" record (type 46). */
+struct UtilMinefield {
+    Uns16 MineId;               /**< Minefield Id. */
+    Uns16 X, Y;                 /**< Center position. */
+    Uns16 Owner;                /**< Owner. */
+    Uns32 Units;                /**< Number of units. */
+    Uns16 Type;                 /**< Type (1=web). */
+    Uns16 PlanetId;             /**< Controlling planet; 0 if none or not given. */
+    Uns16 Reason;               /**< Reason for report (enum MineReason); 0 if not given. */
+};
+
+/** Decoded "transport summary" record (type 0x4080). */
+struct UtilTransportSummary {
+    Uns16 ShipId;               /**< Ship Id. */
+    Uns16 TotalCargo;           /**< Cargo room blocked by starship parts. */
+};
+
+/** Decoded "transport component" record (type 0x4081). */
+struct UtilTransportComponent {
+    Uns16 ShipId;               /**< Ship Id. */
+    Uns16 Type;                 /**< Component type (1=engine, 2=beam, 3=launcher). */
+    Uns16 Slot;                 /**< Slot number. */
+    Uns16 Count;                /**< Number of components. */
+    Uns16 Mass;                 /**< Mass of each component. */
+};
+
+/** Open util file.
+    @param [out] uf   File
+    @param [in]  name File name (in game directory)
+    @return True if file was opened; must be closed using UtilFile_Close(). False if file does not exist. */
+Boolean UtilFile_Open(struct UtilFile* uf, const char* name);
+
+/** Get next record.
+    @param [in,out] uf  File
+    @param [out]    rec Record
+    @return True if a record was returned; false at end of file (check Truncated) */
+Boolean UtilFile_Next(struct UtilFile* uf, struct UtilRecord* rec);
+
+/** Close util file.
+    @param [in,out] uf File */
+void UtilFile_Close(struct UtilFile* uf);
+
+/** Initialize consumer list.
+    @param [out] sc Consumer list */
+void UtilFileScan_Init(struct UtilFileScan* sc);
+
+/** Register a consumer.
+    @param [in,out] sc      Consumer list
+    @param [in]     type    Record type to receive
+    @param [in]     handler Handler
+    @param [in]     context Context passed to handler */
+void UtilFileScan_Add(struct UtilFileScan* sc, Uns16 type, UtilFile_Handler* handler, void* context);
+
+/** Read remainder of util file once, passing each record to all consumers registered for its type.
+    @param [in]     sc Consumer list
+    @param [in,out] uf File, opened using UtilFile_Open()
+    @return True on success; false if the file is truncated (consumers have received all complete records) */
+Boolean UtilFileScan_Run(const struct UtilFileScan* sc, struct UtilFile* uf);
+
+/** Decode "ship built" record.
+    @param [in]  rec Record
+    @param [out] out Result
+    @return True on success; false if record has wrong type or is too short */
+Boolean UtilRecord_GetShipBuilt(const struct UtilRecord* rec, struct UtilShipBuilt* out);
+
+/** Decode "minefield" record.
+    @param [in]  rec Record
+    @param [out] out Result
+    @return True on success; false if record has wrong type or is too short */
+Boolean UtilRecord_GetMinefield(const struct UtilRecord* rec, struct UtilMinefield* out);
+
+/** Decode "transport summary" record.
+    @param [in]  rec Record
+    @param [out] out Result
+    @return True on success; false if record has wrong type or is too short */
+Boolean UtilRecord_GetTransportSummary(const struct UtilRecord* rec, struct UtilTransportSummary* out);
+
+/** Decode "transport component" record.
+    @param [in]  rec Record
+    @param [out] out Result
+    @return True on success; false if record has wrong type or is too short */
+Boolean UtilRecord_GetTransportComponent(const struct UtilRecord* rec, struct UtilTransportComponent* out);
+
+#endif